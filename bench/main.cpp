@@ -0,0 +1,412 @@
+// Headless benchmark of the drawing and fitting paths of every app.
+//
+// Each case is timed over grids from 20x20 to 4096x4096 cells and point
+// counts from 6 to 10^6 (cases whose points do not fit on the grid are
+// skipped). A cell is one pixel here (point_size = patch_size = 1), so a
+// grid of N cells is an N x N canvas. Results are written as CSV or JSON;
+// with --baseline the run is compared against a CSV saved earlier and the
+// exit code is 1 when any case got slower than the tolerance allows.
+//
+// usage: bench [--quick] [--json] [--filter text] [--min-time seconds]
+//              [--out file] [--baseline file] [--tolerance fraction]
+//              [--threads N]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "../q1/draw.h"
+#include "../q2/draw.h"
+#include "../q2_OO/batch_fit.h"
+#include "../q2_OO/circle_ui.h"
+#include "../q3/draw.h"
+
+struct result {
+    std::string name;
+    int grid;
+    int points;
+    int reps;
+    double ns_per_op;
+};
+
+struct options {
+    bool quick = false;
+    bool json = false;
+    std::string filter;
+    double min_time = 0.2;
+    std::string out;
+    std::string baseline;
+    double tolerance = 0.10;
+    int threads = 0;
+};
+
+// run op until min_time has passed (at least 3 and at most 1000 times) and
+// return the median; setup runs before every op and is not timed
+static result time_case(const std::string& name, int grid, int points, double min_time,
+                        std::function<void()> setup, std::function<void()> op){
+    std::vector<double> samples;
+    double total = 0;
+    while((samples.size() < 3 || total < min_time) && samples.size() < 1000){
+        setup();
+        auto t0 = std::chrono::steady_clock::now();
+        op();
+        auto t1 = std::chrono::steady_clock::now();
+        double ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+        samples.push_back(ns);
+        total += ns*1e-9;
+    }
+    std::sort(samples.begin(), samples.end());
+    result r;
+    r.name = name;
+    r.grid = grid;
+    r.points = points;
+    r.reps = (int)samples.size();
+    r.ns_per_op = samples[samples.size()/2];
+    return r;
+}
+
+// distinct cells around a circle of radius grid/3, widening the ring as
+// needed to fit the requested count
+static std::vector<cv::Point> ring_cells(int grid, int count, std::mt19937& rng){
+    std::vector<cv::Point> cells;
+    std::vector<unsigned char> used((size_t)grid*grid, 0);
+    double radius = grid/3.;
+    double spread = 0.5;
+    std::uniform_real_distribution<double> angle(0, 2*M_PI);
+    std::uniform_real_distribution<double> unit(-1, 1);
+    int misses = 0;
+    while((int)cells.size() < count){
+        double a = angle(rng);
+        double r = radius + spread*unit(rng);
+        int x = (int)lround(grid/2. + r*cos(a));
+        int y = (int)lround(grid/2. + r*sin(a));
+        if(x>=0 && x<grid && y>=0 && y<grid && !used[(size_t)y*grid+x]){
+            used[(size_t)y*grid+x] = 1;
+            cells.push_back(cv::Point(x, y));
+            misses = 0;
+        }
+        else if(++misses > 64){
+            spread = std::min(spread*2, (double)grid);
+            misses = 0;
+        }
+    }
+    return cells;
+}
+
+static std::vector<cv::Point> ellipse_points(int grid, int count, std::mt19937& rng){
+    std::vector<cv::Point> points(count);
+    std::uniform_real_distribution<double> angle(0, 2*M_PI);
+    std::normal_distribution<double> noise(0, 1);
+    for(int k = 0; k<count; k++){
+        double a = angle(rng);
+        double x = grid/2. + 0.4*grid*cos(a)*cos(0.3) - 0.2*grid*sin(a)*sin(0.3) + noise(rng);
+        double y = grid/2. + 0.4*grid*cos(a)*sin(0.3) + 0.2*grid*sin(a)*cos(0.3) + noise(rng);
+        points[k] = cv::Point(std::min(std::max((int)lround(x), 0), grid-1), std::min(std::max((int)lround(y), 0), grid-1));
+    }
+    return points;
+}
+
+static std::vector<result> run(const options& opt){
+
+    const int point_size = 1;
+    const int patch_size = 1;
+    cv::Vec3b gray(150, 150, 150);
+    cv::Vec3b blue(255, 0, 0);
+
+    std::vector<int> grids = {20, 64, 256, 1024, 4096};
+    std::vector<int> counts = {6, 100, 10000, 1000000};
+    if(opt.quick){
+        grids = {20, 256};
+        counts = {6, 100};
+    }
+
+    std::vector<result> results;
+    auto wanted = [&](const std::string& name){
+        return opt.filter.empty() || name.find(opt.filter) != std::string::npos;
+    };
+
+    for(size_t g = 0; g<grids.size(); g++){
+        int grid = grids[g];
+        std::mt19937 rng(grid);
+        cv::Mat frame(grid, grid, CV_8UC3, cv::Scalar(255, 255, 255));
+        grid_view view = make_grid_view(grid, grid, point_size, grid);
+        view.patch_size = patch_size;
+        view.width = grid;
+        view.height = grid;
+        q1::grid_params params = q1::engine_params(view);
+        q1::cell center = {grid/2, grid/2};
+        q1::cell end = {grid/2 + grid/3, grid/2};
+
+        if(wanted("q1_select_cells")){
+            std::vector<q1::cell> cells;
+            results.push_back(time_case("q1_select_cells", grid, (int)q1::select_cells(center, end, params).size(), opt.min_time,
+                [](){}, [&](){ cells = q1::select_cells(center, end, params); }));
+        }
+
+        if(wanted("q1_draw_boundary")){
+            std::vector<q1::cell> cells = q1::select_cells(center, end, params);
+            results.push_back(time_case("q1_draw_boundary", grid, (int)cells.size(), opt.min_time,
+                [](){}, [&](){ q1::draw_boundary(&frame, view, cells, cv::Point(center.x, center.y)); }));
+        }
+
+        // one rotated ellipse over most of the canvas; the rasterizer only
+        // visits the rows of its bounding box and the band around the curve
+        if(wanted("q3_paint_ellipse")){
+            cv::RotatedRect shape(cv::Point2f(grid/2.f, grid/2.f), cv::Size2f(0.8f*grid, 0.4f*grid), 17.f);
+            results.push_back(time_case("q3_paint_ellipse", grid, 0, opt.min_time, [](){}, [&](){
+                q3::paint_ellipse(&frame, view, shape, blue);
+            }));
+        }
+
+        for(size_t c = 0; c<counts.size(); c++){
+            int count = counts[c];
+            bool fits = (double)count <= 0.5*grid*grid;
+
+            if(fits && wanted("cell_set_walk")){
+                std::vector<cv::Point> cells = ring_cells(grid, count, rng);
+                cell_set selected;
+                for(size_t k = 0; k<cells.size(); k++)
+                    selected.insert(cells[k].x, cells[k].y);
+                int64_t total = 0;
+                results.push_back(time_case("cell_set_walk", grid, count, opt.min_time, [](){}, [&](){
+                    selected.for_each([&](int x, int y){ total += x + y; });
+                }));
+            }
+
+            if(fits && wanted("q1_draw")){
+                std::vector<cv::Point> cells = ring_cells(grid, count, rng);
+                results.push_back(time_case("q1_draw", grid, count, opt.min_time, [](){}, [&](){
+                    for(size_t k = 0; k<cells.size(); k++)
+                        q1::draw(&frame, view, cells[k], blue);
+                }));
+            }
+
+            // the algebraic fits only read the sums, O(1) in the point count;
+            // RANSAC scores every point for each hypothesis
+            if(fits && (wanted("q2_draw_circle") || wanted("q2_fit"))){
+                std::vector<cv::Point> cells = ring_cells(grid, count, rng);
+                cell_set selected;
+                circle_sums sums;
+                for(size_t k = 0; k<cells.size(); k++){
+                    selected.insert(cells[k].x, cells[k].y);
+                    sums.add_cell(view, cells[k].x, cells[k].y);
+                }
+                cv::Point2d center;
+                double radius;
+                if(wanted("q2_draw_circle")){
+                    results.push_back(time_case("q2_draw_circle", grid, count, opt.min_time, [](){}, [&](){
+                        q2::draw_circle(circle_mean, sums, selected, view, &frame, blue, &center, &radius);
+                    }));
+                }
+                const char *fit_names[] = {"q2_fit_kasa", "q2_fit_pratt", "q2_fit_taubin"};
+                for(int m = circle_kasa; m<=circle_taubin; m++){
+                    std::string name = fit_names[m - circle_kasa];
+                    if(!wanted(name))
+                        continue;
+                    double cx, cy, r;
+                    results.push_back(time_case(name, grid, count, opt.min_time, [](){}, [&](){
+                        sums.solve((circle_method)m, &cx, &cy, &r);
+                    }));
+                }
+                if(wanted("q2_fit_ransac")){
+                    std::vector<int> cell_xs, cell_ys;
+                    results.push_back(time_case("q2_fit_ransac", grid, count, opt.min_time, [](){}, [&](){
+                        ransac::fit_cells(selected, view, &cell_xs, &cell_ys, ransac::cell_options(view));
+                    }));
+                }
+            }
+
+            // same grid x grid canvas as the other cases
+            if(fits && wanted("q2_OO_draw_circle")){
+                std::vector<cv::Point> cells = ring_cells(grid, count, rng);
+                circleUI object(view, gray);
+                results.push_back(time_case("q2_OO_draw_circle", grid, count, opt.min_time, [&](){
+                    object.reset();
+                    for(size_t k = 0; k<cells.size(); k++)
+                        object.select(cells[k], blue);
+                }, [&](){
+                    object.draw_circle(blue);
+                }));
+            }
+
+            // the Generate path of q3/main.cpp: direct fit of the selection,
+            // then the outline and its overlay entries. The selection drops
+            // repeated cells, so it is reported by its size, and skipped once
+            // the curve holds fewer than half the points asked for
+            if(wanted("q3_draw_ellipse")){
+                std::vector<cv::Point> cells = ellipse_points(grid, count, rng);
+                q3::selection selected(view);
+                for(size_t k = 0; k<cells.size(); k++)
+                    selected.insert(cells[k].x, cells[k].y);
+                if(2*selected.size() >= (size_t)count){
+                    cv::Mat background = frame.clone();
+                    overlay layer;
+                    cv::RotatedRect fitted;
+                    results.push_back(time_case("q3_draw_ellipse", grid, (int)selected.size(), opt.min_time, [&](){
+                        layer.clear(&frame, background);
+                    }, [&](){
+                        q3::draw_ellipse(q3::ellipse_direct, selected, view, &frame, blue, &fitted, &layer);
+                    }));
+                }
+            }
+
+            // the direct fit only reads the running moments
+            if(wanted("q3_fit_direct")){
+                std::vector<cv::Point> points = ellipse_points(grid, count, rng);
+                ellipse_sums sums;
+                for(size_t k = 0; k<points.size(); k++)
+                    sums.add(points[k].x, points[k].y);
+                ellipse_params fit;
+                results.push_back(time_case("q3_fit_direct", grid, count, opt.min_time, [](){}, [&](){
+                    sums.solve(&fit);
+                }));
+            }
+
+            // a quarter of the points are scattered over the canvas; the
+            // threshold covers the unit noise of ellipse_points
+            if(wanted("q3_fit_ransac")){
+                std::vector<cv::Point> points = ellipse_points(grid, count, rng);
+                std::uniform_int_distribution<int> anywhere(0, grid-1);
+                std::vector<float> xs(points.size()), ys(points.size());
+                for(size_t k = 0; k<points.size(); k++){
+                    xs[k] = k%4 == 3 ? (float)anywhere(rng) : (float)points[k].x;
+                    ys[k] = k%4 == 3 ? (float)anywhere(rng) : (float)points[k].y;
+                }
+                ransac::options fit_opt;
+                fit_opt.threshold = 2;
+                results.push_back(time_case("q3_fit_ransac", grid, count, opt.min_time, [](){}, [&](){
+                    ransac::fit_ellipse(xs, ys, fit_opt);
+                }));
+            }
+        }
+    }
+
+    // many small independent sets of 6 to 100 points, fitted in one call;
+    // reported with grid 0 and the number of sets as points
+    if(wanted("q2_OO_batch_fit")){
+        int set_count = opt.quick ? 1000 : 100000;
+        std::mt19937 rng(7);
+        std::uniform_int_distribution<int> size(6, 100);
+        point_sets sets;
+        for(int k = 0; k<set_count; k++){
+            std::vector<cv::Point> cells = ring_cells(64, size(rng), rng);
+            for(size_t i = 0; i<cells.size(); i++)
+                sets.push(cells[i].x, cells[i].y);
+            sets.end_set();
+        }
+        results.push_back(time_case("q2_OO_batch_fit", 0, set_count, opt.min_time, [](){}, [&](){
+            fit_point_sets(sets);
+        }));
+    }
+    return results;
+}
+
+static void write_results(std::ostream& out, const std::vector<result>& results, bool json){
+    char line[256];
+    if(json){
+        out << "[\n";
+        for(size_t k = 0; k<results.size(); k++){
+            const result& r = results[k];
+            snprintf(line, sizeof(line), "  {\"case\": \"%s\", \"grid\": %d, \"points\": %d, \"reps\": %d, \"ns_per_op\": %.1f}%s\n",
+                     r.name.c_str(), r.grid, r.points, r.reps, r.ns_per_op, k+1 < results.size() ? "," : "");
+            out << line;
+        }
+        out << "]\n";
+        return;
+    }
+    out << "case,grid,points,reps,ns_per_op\n";
+    for(size_t k = 0; k<results.size(); k++){
+        const result& r = results[k];
+        snprintf(line, sizeof(line), "%s,%d,%d,%d,%.1f\n", r.name.c_str(), r.grid, r.points, r.reps, r.ns_per_op);
+        out << line;
+    }
+}
+
+// compare against a CSV written by an earlier run; returns false when any
+// case is slower than baseline*(1+tolerance)
+static bool compare(const std::vector<result>& results, const std::string& path, double tolerance){
+    std::ifstream in(path);
+    if(!in){
+        std::cerr << "Error: cannot open baseline " << path << std::endl;
+        return false;
+    }
+    std::map<std::string, double> baseline;
+    std::string line;
+    std::getline(in, line);
+    while(std::getline(in, line)){
+        std::stringstream ss(line);
+        std::string name, grid, points, reps, ns;
+        if(std::getline(ss, name, ',') && std::getline(ss, grid, ',') && std::getline(ss, points, ',') &&
+           std::getline(ss, reps, ',') && std::getline(ss, ns, ','))
+            baseline[name + "," + grid + "," + points] = atof(ns.c_str());
+    }
+
+    bool ok = true;
+    for(size_t k = 0; k<results.size(); k++){
+        const result& r = results[k];
+        std::string key = r.name + "," + std::to_string(r.grid) + "," + std::to_string(r.points);
+        auto it = baseline.find(key);
+        if(it == baseline.end() || it->second <= 0)
+            continue;
+        double ratio = r.ns_per_op/it->second;
+        bool slower = ratio > 1. + tolerance;
+        fprintf(stderr, "%-20s grid %5d points %8d  %10.1f -> %10.1f ns  x%.2f%s\n", r.name.c_str(), r.grid, r.points,
+                it->second, r.ns_per_op, ratio, slower ? "  SLOWER" : "");
+        if(slower)
+            ok = false;
+    }
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    options opt;
+    for(int k = 1; k<argc; k++){
+        std::string arg = argv[k];
+        if(arg == "--quick")
+            opt.quick = true;
+        else if(arg == "--json")
+            opt.json = true;
+        else if(arg == "--filter" && k+1<argc)
+            opt.filter = argv[++k];
+        else if(arg == "--min-time" && k+1<argc)
+            opt.min_time = atof(argv[++k]);
+        else if(arg == "--out" && k+1<argc)
+            opt.out = argv[++k];
+        else if(arg == "--baseline" && k+1<argc)
+            opt.baseline = argv[++k];
+        else if(arg == "--tolerance" && k+1<argc)
+            opt.tolerance = atof(argv[++k]);
+        else if(arg == "--threads" && k+1<argc)
+            opt.threads = atoi(argv[++k]);
+        else{
+            std::cerr << "usage: bench [--quick] [--json] [--filter text] [--min-time seconds] [--out file] [--baseline file] [--tolerance fraction] [--threads N]" << std::endl;
+            return 1;
+        }
+    }
+
+    if(opt.threads > 0)
+        parallel::set_thread_count(opt.threads);
+    std::vector<result> results = run(opt);
+
+    if(opt.out.empty())
+        write_results(std::cout, results, opt.json);
+    else{
+        std::ofstream out(opt.out);
+        write_results(out, results, opt.json);
+    }
+
+    if(!opt.baseline.empty() && !compare(results, opt.baseline, opt.tolerance))
+        return 1;
+    return 0;
+}
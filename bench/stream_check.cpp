@@ -0,0 +1,101 @@
+// Delivery check for common/point_stream.h, apart from the benchmark.
+//
+// A set finished while the caller is still busy with the previous batch
+// has to reach the caller without more input. The check feeds a pipe it
+// keeps open, one set at a time, and writes the next set only once the
+// parser has drained the previous one, so the sets are parsed and handed
+// over in a fixed order no matter how the threads are scheduled:
+//
+//     set 0, taken by the caller
+//     set 1, handed over while the caller does not ask
+//     set 2, parsed while set 1 still waits for the caller
+//
+// The caller then asks for sets 1 and 2 with the pipe still open. A reader
+// that holds set 2 back until more input never delivers it; a watchdog
+// closes the pipe after a few seconds so the run ends and reports it.
+//
+// usage: stream_check; the exit code is 1 when a set was held back
+
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include "../common/point_stream.h"
+
+// write one set of four points and wait until the parser has read it
+static bool write_set(int fds[2]){
+    const char set[] = "10 0\n0 10\n-10 0\n0 -10\nfit\n";
+    if(write(fds[1], set, sizeof(set) - 1) != (ssize_t)(sizeof(set) - 1))
+        return false;
+    int unread = 1;
+    while(unread > 0){
+        if(ioctl(fds[0], FIONREAD, &unread) != 0)
+            return false;
+        if(unread > 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+int main()
+{
+    int fds[2];
+    if(pipe(fds) != 0){
+        std::cerr << "Error: cannot create a pipe" << std::endl;
+        return 1;
+    }
+
+    // closes the write end once; by the watchdog when the sets never come
+    std::mutex lock;
+    std::condition_variable changed;
+    bool delivered = false, closed = false, timed_out = false;
+    auto close_pipe = [&](){
+        if(!closed){
+            close(fds[1]);
+            closed = true;
+        }
+    };
+
+    uint64_t received = 0;
+    {
+        point_stream::reader reader(fds[0]);
+        point_stream::batch sets;
+        bool ok = write_set(fds) && reader.next(&sets) && sets.size() == 1;
+        ok = ok && write_set(fds) && write_set(fds);
+        if(!ok){
+            std::cerr << "Error: cannot feed the stream" << std::endl;
+            std::lock_guard<std::mutex> guard(lock);
+            close_pipe();
+        }
+        else{
+            received = 1;
+            std::thread watchdog([&](){
+                std::unique_lock<std::mutex> guard(lock);
+                if(!changed.wait_for(guard, std::chrono::seconds(5), [&](){ return delivered; })){
+                    timed_out = true;
+                    close_pipe();
+                }
+            });
+            while(received < 3 && reader.next(&sets))
+                received += sets.size();
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                delivered = true;
+                close_pipe();
+            }
+            changed.notify_all();
+            watchdog.join();
+        }
+    }
+    close(fds[0]);
+
+    if(received != 3 || timed_out){
+        std::cerr << "Error: point_stream held a set back until more input arrived" << std::endl;
+        return 1;
+    }
+    std::cout << "point_stream delivery: ok" << std::endl;
+    return 0;
+}
@@ -0,0 +1,294 @@
+#ifndef COMMON_CIRCLE_FIT_H
+#define COMMON_CIRCLE_FIT_H
+
+// Incremental circle fits. circle_sums keeps the moment sums of the
+// selected points, updated in O(1) on every select and deselect, so no
+// pass over the grid is ever needed:
+//
+//   mean    centroid plus mean distance; the distance needs one pass over
+//           the k selected cells and is biased towards the centroid on arcs
+//   kasa    algebraic least squares, a 2x2 solve; fast but also biased on
+//           short arcs
+//   pratt   algebraic fit with Pratt's normalization
+//   taubin  algebraic fit with Taubin's normalization, the most accurate
+//           of the three in practice
+//   ransac  robust fit for selections with outliers, see ransac.h; it
+//           needs the points themselves, so it is not handled here
+//
+// Pratt and Taubin follow Chernov's formulation: the centered moments give
+// a cubic (quartic for Pratt) whose smallest root is found by Newton's
+// method from 0, after which the center is a closed-form 2x2 solve.
+//
+// The moments are integer sums around the first point added, kept modulo
+// 2^128 so removals never drift. Before solving they are moved, still in
+// integers, to the pixel nearest the centroid; the result is exact while
+// every point is within 2^24 pixels of the centroid and fewer than 2^28
+// points are selected, however far the origin has been left behind by
+// removals. Only the last sub-pixel shift is done in long double, on
+// moments already centered, so it loses no more than a few ulps.
+
+#include <math.h>
+#include <stdint.h>
+#include "grid_view.h"
+
+enum circle_method { circle_mean, circle_kasa, circle_pratt, circle_taubin, circle_ransac };
+
+inline const char *circle_method_name(circle_method method){
+    switch(method){
+    case circle_mean: return "Mean";
+    case circle_kasa: return "Kasa";
+    case circle_pratt: return "Pratt";
+    case circle_taubin: return "Taubin";
+    default: return "RANSAC";
+    }
+}
+
+inline circle_method next_circle_method(circle_method method){
+    return (circle_method)((method + 1) % 5);
+}
+
+// moments of a point set about its centroid: Mxx = mean(X^2) and so on,
+// with Z = X^2 + Y^2
+struct circle_moments {
+    double Mxx, Myy, Mxy;
+    double Mxz, Myz, Mzz;
+};
+
+// algebraic fit from centered moments; the center is returned relative to
+// the centroid. False when the points are (nearly) collinear.
+inline bool solve_circle_moments(circle_method method, const circle_moments& m, double *dx, double *dy, double *radius){
+    double Mxx = m.Mxx, Myy = m.Myy, Mxy = m.Mxy;
+    double Mxz = m.Mxz, Myz = m.Myz, Mzz = m.Mzz;
+    double Mz = Mxx + Myy;
+    double cov_xy = Mxx*Myy - Mxy*Mxy;
+    double var_z = Mzz - Mz*Mz;
+
+    // root of the characteristic polynomial; 0 gives the Kasa fit
+    double root = 0;
+    if(method == circle_pratt || method == circle_taubin){
+        double A3 = method == circle_taubin ? 4*Mz : 0;
+        double A2 = method == circle_taubin ? -3*Mz*Mz - Mzz : 4*cov_xy - 3*Mz*Mz - Mzz;
+        double A4 = method == circle_pratt ? 4 : 0;
+        double A1 = var_z*Mz + 4*cov_xy*Mz - Mxz*Mxz - Myz*Myz;
+        double A0 = Mxz*(Mxz*Myy - Myz*Mxy) + Myz*(Myz*Mxx - Mxz*Mxy) - var_z*cov_xy;
+        double y = A0;
+        for(int iter = 0; iter<20; iter++){
+            double slope = A1 + root*(2*A2 + root*(3*A3 + 4*A4*root));
+            double next = root - y/slope;
+            if(next == root || !isfinite(next))
+                break;
+            double y_next = A0 + next*(A1 + next*(A2 + next*(A3 + next*A4)));
+            if(fabs(y_next) >= fabs(y))
+                break;
+            root = next;
+            y = y_next;
+        }
+        if(root < 0)
+            root = 0;
+    }
+
+    double det = root*root - root*Mz + cov_xy;
+    if(fabs(det) <= 1e-12*Mz*Mz)
+        return false;
+    *dx = (Mxz*(Myy - root) - Myz*Mxy)/det/2;
+    *dy = (Myz*(Mxx - root) - Mxz*Mxy)/det/2;
+    double r2 = (*dx)*(*dx) + (*dy)*(*dy) + Mz + (method == circle_pratt ? 2*root : 0);
+    if(!(r2 >= 0))
+        return false;
+    *radius = sqrt(r2);
+    return true;
+}
+
+class circle_sums
+{
+public:
+    // a point (canvas pixels) was selected or deselected
+    void add(int64_t x, int64_t y){
+        if(n == 0){
+            ox = x;
+            oy = y;
+        }
+        accumulate(x-ox, y-oy, 1);
+        n++;
+    }
+    void remove(int64_t x, int64_t y){
+        accumulate(x-ox, y-oy, -1);
+        n--;
+        if(n == 0)
+            clear();
+    }
+    void clear(){
+        *this = circle_sums();
+    }
+
+    // the center of a cell of the view was selected or deselected
+    void add_cell(const grid_view& view, int x, int y){ add(view.center_x(x), view.center_y(y)); }
+    void remove_cell(const grid_view& view, int x, int y){ remove(view.center_x(x), view.center_y(y)); }
+
+    int64_t count() const { return n; }
+    int64_t sum_x() const { return ox*n + (int64_t)(__int128)sx; }
+    int64_t sum_y() const { return oy*n + (int64_t)(__int128)sy; }
+
+    // centroid, truncated to whole pixels; count() must not be 0
+    int64_t center_x() const { return sum_x()/n; }
+    int64_t center_y() const { return sum_y()/n; }
+
+    // algebraic fit in canvas pixels; false with fewer than 3 points or
+    // when they are (nearly) collinear. circle_mean is not handled here,
+    // see fit_circle().
+    bool solve(circle_method method, double *cx, double *cy, double *radius) const {
+        if(n < 3 || method == circle_mean || method == circle_ransac)
+            return false;
+
+        // move the sums to the pixel (ox + c, oy + d) nearest the centroid,
+        // exactly, in the same wrapping integer arithmetic
+        int64_t c = (int64_t)llroundl((long double)(__int128)sx/n);
+        int64_t d = (int64_t)llroundl((long double)(__int128)sy/n);
+        unsigned __int128 C = (unsigned __int128)c, D = (unsigned __int128)d, E = C*C + D*D, U = (unsigned __int128)n;
+        unsigned __int128 sz = sxx + syy;
+        unsigned __int128 Sx_ = sx - C*U, Sy_ = sy - D*U;
+        unsigned __int128 Sxx_ = sxx - 2*C*sx + C*C*U;
+        unsigned __int128 Syy_ = syy - 2*D*sy + D*D*U;
+        unsigned __int128 Sxy_ = sxy - C*sy - D*sx + C*D*U;
+        unsigned __int128 Sz_ = sz - 2*C*sx - 2*D*sy + E*U;
+        unsigned __int128 Sxz_ = sxz - 2*C*sxx - 2*D*sxy + E*sx - C*Sz_;
+        unsigned __int128 Syz_ = syz - 2*C*sxy - 2*D*syy + E*sy - D*Sz_;
+        unsigned __int128 Szz_ = szz + 4*C*C*sxx + 4*D*D*syy + E*E*U - 4*C*sxz - 4*D*syz + 2*E*sz + 8*C*D*sxy
+                               - 4*C*E*sx - 4*D*E*sy;
+
+        // the remaining sub-pixel shift to the centroid, on moments that
+        // are already centered to within half a pixel
+        long double N = (long double)n;
+        long double Sxx = (long double)(__int128)Sxx_, Sxy = (long double)(__int128)Sxy_, Syy = (long double)(__int128)Syy_;
+        long double Sx = (long double)(__int128)Sx_, Sy = (long double)(__int128)Sy_;
+        long double Sz = (long double)(__int128)Sz_;
+        long double Sxz = (long double)(__int128)Sxz_, Syz = (long double)(__int128)Syz_, Szz = (long double)(__int128)Szz_;
+        long double a = Sx/N;
+        long double b = Sy/N;
+        long double e = a*a + b*b;
+
+        // Z = X^2 + Y^2 of the centered point = z - 2ax - 2by + e
+        long double sum_Z = Sz - 2*a*Sx - 2*b*Sy + e*N;
+        long double sum_xZ = Sxz - 2*a*Sxx - 2*b*Sxy + e*Sx;
+        long double sum_yZ = Syz - 2*a*Sxy - 2*b*Syy + e*Sy;
+        long double sum_ZZ = Szz + 4*a*a*Sxx + 4*b*b*Syy + 8*a*b*Sxy + e*e*N
+                           - 4*a*Sxz - 4*b*Syz + 2*e*Sz - 4*a*e*Sx - 4*b*e*Sy;
+
+        circle_moments m;
+        m.Mxx = (double)(Sxx/N - a*a);
+        m.Myy = (double)(Syy/N - b*b);
+        m.Mxy = (double)(Sxy/N - a*b);
+        m.Mxz = (double)((sum_xZ - a*sum_Z)/N);
+        m.Myz = (double)((sum_yZ - b*sum_Z)/N);
+        m.Mzz = (double)(sum_ZZ/N);
+        double dx, dy;
+        if(!solve_circle_moments(method, m, &dx, &dy, radius))
+            return false;
+        *cx = (double)(ox + c) + (double)a + dx;
+        *cy = (double)(oy + d) + (double)b + dy;
+        return true;
+    }
+
+private:
+    // sums wrap modulo 2^128, so a removal always undoes its add exactly
+    void accumulate(int64_t x, int64_t y, int sign){
+        unsigned __int128 X = (unsigned __int128)x, Y = (unsigned __int128)y;
+        if(sign < 0){
+            X = -X;
+            Y = -Y;
+        }
+        unsigned __int128 z = (unsigned __int128)x*x + (unsigned __int128)y*y;
+        sx += X;
+        sy += Y;
+        sxx += X*x;
+        sxy += X*y;
+        syy += Y*y;
+        sxz += X*z;
+        syz += Y*z;
+        szz += (sign < 0 ? -z : z)*z;
+    }
+
+    int64_t n = 0;
+    int64_t ox = 0;
+    int64_t oy = 0;
+    unsigned __int128 sx = 0, sy = 0;
+    unsigned __int128 sxx = 0, sxy = 0, syy = 0;
+    unsigned __int128 sxz = 0, syz = 0, szz = 0;
+};
+
+// mean distance of the selected cells from (cx, cy), in canvas pixels
+inline double mean_radius(const cell_set& selected, const grid_view& view, double cx, double cy){
+    if(selected.size() == 0)
+        return 0;
+    double total = 0;
+    selected.for_each([&](int x, int y){
+        double dx = (double)view.center_x(x) - cx;
+        double dy = (double)view.center_y(y) - cy;
+        total += sqrt(dx*dx + dy*dy);
+    });
+    return total/selected.size();
+}
+
+// fit a circle to n points given as arrays of any numeric type: one pass
+// for the centroid and one for the moments about it. circle_ransac is left
+// to ransac.h.
+template<class T>
+inline bool fit_point_array(circle_method method, const T *xs, const T *ys, size_t n,
+                            double *cx, double *cy, double *radius){
+    if(n == 0 || method == circle_ransac || (n < 3 && method != circle_mean))
+        return false;
+    double mx = 0, my = 0;
+    for(size_t k = 0; k<n; k++){
+        mx += xs[k];
+        my += ys[k];
+    }
+    mx /= n;
+    my /= n;
+
+    if(method == circle_mean){
+        double total = 0;
+        for(size_t k = 0; k<n; k++)
+            total += sqrt((xs[k]-mx)*(xs[k]-mx) + (ys[k]-my)*(ys[k]-my));
+        *cx = mx;
+        *cy = my;
+        *radius = total/n;
+        return true;
+    }
+
+    circle_moments m = {0, 0, 0, 0, 0, 0};
+    for(size_t k = 0; k<n; k++){
+        double x = xs[k] - mx;
+        double y = ys[k] - my;
+        double z = x*x + y*y;
+        m.Mxx += x*x;
+        m.Myy += y*y;
+        m.Mxy += x*y;
+        m.Mxz += x*z;
+        m.Myz += y*z;
+        m.Mzz += z*z;
+    }
+    m.Mxx /= n; m.Myy /= n; m.Mxy /= n;
+    m.Mxz /= n; m.Myz /= n; m.Mzz /= n;
+    double dx, dy;
+    if(!solve_circle_moments(method, m, &dx, &dy, radius))
+        return false;
+    *cx = mx + dx;
+    *cy = my + dy;
+    return true;
+}
+
+// fit a circle to the selection with the given method, in canvas pixels;
+// circle_ransac is left to ransac::fit_cells
+inline bool fit_circle(circle_method method, const circle_sums& sums, const cell_set& selected, const grid_view& view,
+                       double *cx, double *cy, double *radius){
+    if(sums.count() == 0 || method == circle_ransac)
+        return false;
+    if(method != circle_mean)
+        return sums.solve(method, cx, cy, radius);
+    *cx = (double)sums.center_x();
+    *cy = (double)sums.center_y();
+    *radius = mean_radius(selected, view, *cx, *cy);
+    return true;
+}
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef COMMON_ELLIPSE_DETECT_H
+#define COMMON_ELLIPSE_DETECT_H
+
+// Several ellipses from one selection: the selected cells are split into
+// connected components and every component gets its own direct fit.
+//
+// Two cells are connected when they are at most gap cells apart along
+// both axes, so an outline clicked with small holes still forms one
+// component. Components are found with union-find over the packed points
+// of a point_set, looking up the neighbours of each cell in its index, and
+// are fitted in parallel on the shared thread pool.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+#include "ellipse_fit.h"
+#include "point_set.h"
+#include "thread_pool.h"
+
+struct detected_ellipse {
+    ellipse_params fit;
+    size_t points;
+};
+
+// group the points into components, laid out like point_sets in
+// q2_OO/batch_fit.h: component k holds xs[i], ys[i] for
+// offsets[k] <= i < offsets[k+1]. Components come in order of their
+// first point.
+inline void cluster_points(const point_set& points, int gap, std::vector<uint64_t> *offsets,
+                           std::vector<float> *xs, std::vector<float> *ys){
+    size_t n = points.size();
+    std::vector<uint32_t> parent(n);
+    for(size_t k = 0; k<n; k++)
+        parent[k] = (uint32_t)k;
+    auto find = [&](uint32_t k){
+        while(parent[k] != k){
+            parent[k] = parent[parent[k]];
+            k = parent[k];
+        }
+        return k;
+    };
+
+    // only the forward half of the neighbourhood, every pair is seen once
+    for(size_t k = 0; k<n; k++){
+        int x = points.cell_x(k), y = points.cell_y(k);
+        for(int dy = 0; dy<=gap; dy++){
+            for(int dx = dy == 0 ? 1 : -gap; dx<=gap; dx++){
+                int64_t other = points.slot(x + dx, y + dy);
+                if(other < 0)
+                    continue;
+                uint32_t a = find((uint32_t)k), b = find((uint32_t)other);
+                if(a != b)
+                    parent[std::max(a, b)] = std::min(a, b);
+            }
+        }
+    }
+
+    // counting sort by root
+    std::vector<uint32_t> label(n, UINT32_MAX), sizes;
+    for(size_t k = 0; k<n; k++){
+        uint32_t root = find((uint32_t)k);
+        if(label[root] == UINT32_MAX){
+            label[root] = (uint32_t)sizes.size();
+            sizes.push_back(0);
+        }
+        sizes[label[root]]++;
+    }
+    offsets->assign(sizes.size() + 1, 0);
+    for(size_t c = 0; c<sizes.size(); c++)
+        (*offsets)[c+1] = (*offsets)[c] + sizes[c];
+    std::vector<uint64_t> next(offsets->begin(), offsets->end() - 1);
+    xs->resize(n);
+    ys->resize(n);
+    for(size_t k = 0; k<n; k++){
+        uint64_t at = next[label[find((uint32_t)k)]]++;
+        (*xs)[at] = points.xs()[k];
+        (*ys)[at] = points.ys()[k];
+    }
+}
+
+// fit an ellipse to every component of at least min_points points and
+// return the ones that fitted, in component order
+inline std::vector<detected_ellipse> detect_ellipses(const point_set& points, int gap = 2, size_t min_points = 6){
+    std::vector<uint64_t> offsets;
+    std::vector<float> xs, ys;
+    cluster_points(points, gap, &offsets, &xs, &ys);
+
+    size_t count = offsets.size() - 1;
+    std::vector<detected_ellipse> fits(count);
+    std::vector<char> found(count, 0);
+    parallel::parallel_for_stealing(0, (int64_t)count, 4, [&](int64_t begin, int64_t end){
+        for(int64_t k = begin; k<end; k++){
+            size_t n = (size_t)(offsets[k+1] - offsets[k]);
+            fits[k].points = n;
+            found[k] = n >= min_points && fit_ellipse_points(xs.data() + offsets[k], ys.data() + offsets[k], n, &fits[k].fit);
+        }
+    });
+
+    std::vector<detected_ellipse> result;
+    for(size_t k = 0; k<count; k++){
+        if(found[k])
+            result.push_back(fits[k]);
+    }
+    return result;
+}
+
+#endif
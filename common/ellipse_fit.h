@@ -0,0 +1,357 @@
+#ifndef COMMON_ELLIPSE_FIT_H
+#define COMMON_ELLIPSE_FIT_H
+
+// Incremental direct least-squares ellipse fit (Fitzgibbon, Pilu and
+// Fisher, in the numerically stable form of Halir and Flusser).
+//
+// The fit only needs the 6x6 scatter matrix of the design rows
+// [x^2, xy, y^2, x, y, 1], whose entries are the 15 moments sum(x^p y^q)
+// with p + q <= 4. ellipse_sums keeps those moments up to date in O(1) on
+// every select and deselect, so a fit is a 3x3 eigenproblem and never
+// touches the points.
+//
+// Like circle_sums, the moments are integer sums around the first point
+// added, kept modulo 2^128 so removals never drift, and are moved exactly
+// to the pixel nearest the centroid before solving. That is exact while
+// every point is within 2^20 pixels of the centroid and fewer than 2^40
+// points are selected, wherever the origin is. The last sub-pixel shift
+// and the scaling to unit spread, which keeps the scatter matrix well
+// conditioned on large canvases, are done in long double on moments that
+// are already centered.
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "grid_view.h"
+
+// ellipse in canvas pixels: center, full axis lengths and the angle of the
+// width axis in degrees, as in cv::RotatedRect
+struct ellipse_params {
+    double center_x;
+    double center_y;
+    double width;
+    double height;
+    double angle;
+};
+
+// normalized moments of a point set: m[p][q] = mean(X^p Y^q) for p + q <= 4
+// with X = (x - cx)/scale and Y = (y - cy)/scale
+struct ellipse_moments {
+    double m[5][5];
+    double cx;
+    double cy;
+    double scale;
+};
+
+// real roots of x^3 + a x^2 + b x + c; returns how many
+inline int solve_cubic(double a, double b, double c, double roots[3]){
+    double q = (a*a - 3*b)/9;
+    double r = (2*a*a*a - 9*a*b + 27*c)/54;
+    if(r*r < q*q*q){
+        double t = acos(r/sqrt(q*q*q));
+        double s = -2*sqrt(q);
+        roots[0] = s*cos(t/3) - a/3;
+        roots[1] = s*cos((t + 2*M_PI)/3) - a/3;
+        roots[2] = s*cos((t - 2*M_PI)/3) - a/3;
+        return 3;
+    }
+    double u = -cbrt(r + (r < 0 ? -1 : 1)*sqrt(r*r - q*q*q));
+    double v = u == 0 ? 0 : q/u;
+    roots[0] = u + v - a/3;
+    return 1;
+}
+
+// center, axes and angle of the conic A x^2 + B xy + C y^2 + D x + E y + F
+// = 0, given in units of scale around (cx, cy); false unless it is a real
+// ellipse
+inline bool conic_to_ellipse(const double conic[6], double cx, double cy, double scale, ellipse_params *fit){
+    double A = conic[0], B = conic[1], C = conic[2], D = conic[3], E = conic[4], F = conic[5];
+    if(A + C < 0){
+        A = -A; B = -B; C = -C; D = -D; E = -E; F = -F;
+    }
+    double disc = B*B - 4*A*C;
+    if(!(disc < 0))
+        return false;
+    double x0 = (2*C*D - B*E)/disc;
+    double y0 = (2*A*E - B*D)/disc;
+    double F0 = F + (D*x0 + E*y0)/2;
+    double R = sqrt((A - C)*(A - C)/4 + B*B/4);
+    double lu = (A + C)/2 + R, lv = (A + C)/2 - R;
+    if(!(F0 < 0) || !(lv > 0))
+        return false;
+
+    double theta = 0.5*atan2(B, A - C);
+    fit->center_x = cx + scale*x0;
+    fit->center_y = cy + scale*y0;
+    fit->width = 2*scale*sqrt(-F0/lu);
+    fit->height = 2*scale*sqrt(-F0/lv);
+    fit->angle = theta*180/M_PI;
+    return isfinite(fit->center_x) && isfinite(fit->center_y) && isfinite(fit->width) && isfinite(fit->height);
+}
+
+// the conic of an ellipse, in units of scale around (cx, cy); the inverse
+// of conic_to_ellipse up to a factor
+inline void ellipse_to_conic(const ellipse_params& fit, double cx, double cy, double scale, double conic[6]){
+    double a = fit.width/2/scale, b = fit.height/2/scale;
+    double x0 = (fit.center_x - cx)/scale, y0 = (fit.center_y - cy)/scale;
+    double t = fit.angle*M_PI/180;
+    double c = cos(t), s = sin(t);
+    double A = c*c/(a*a) + s*s/(b*b);
+    double B = 2*c*s*(1/(a*a) - 1/(b*b));
+    double C = s*s/(a*a) + c*c/(b*b);
+    conic[0] = A;
+    conic[1] = B;
+    conic[2] = C;
+    conic[3] = -2*A*x0 - B*y0;
+    conic[4] = -B*x0 - 2*C*y0;
+    conic[5] = A*x0*x0 + B*x0*y0 + C*y0*y0 - 1;
+}
+
+// direct fit from normalized moments; the fit is always an ellipse, false
+// when the points do not determine one (fewer than 6 distinct points or
+// all of them on a line)
+inline bool solve_ellipse_moments(const ellipse_moments& mo, ellipse_params *fit){
+    static const int px[6] = {2, 1, 0, 1, 0, 0};
+    static const int py[6] = {0, 1, 2, 0, 1, 0};
+    double S[6][6];
+    for(int r = 0; r<6; r++)
+        for(int c = 0; c<6; c++)
+            S[r][c] = mo.m[px[r] + px[c]][py[r] + py[c]];
+
+    // S = [S1 S2; S2' S3]; T = -inv(S3) S2' eliminates the linear terms
+    double a = S[3][3], b = S[3][4], c = S[3][5];
+    double d = S[4][4], e = S[4][5], f = S[5][5];
+    double i00 = d*f - e*e, i01 = c*e - b*f, i02 = b*e - c*d;
+    double i11 = a*f - c*c, i12 = b*c - a*e, i22 = a*d - b*b;
+    double det = a*i00 + b*i01 + c*i02;
+    if(!(fabs(det) > 1e-12))
+        return false;
+    double inv3[3][3] = {{i00, i01, i02}, {i01, i11, i12}, {i02, i12, i22}};
+    double T[3][3];
+    for(int r = 0; r<3; r++)
+        for(int k = 0; k<3; k++){
+            double sum = 0;
+            for(int j = 0; j<3; j++)
+                sum += inv3[r][j]*S[k][3 + j];
+            T[r][k] = -sum/det;
+        }
+
+    // reduced scatter M = S1 + S2 T, premultiplied by the inverse of the
+    // constraint 4ac - b^2 = 1
+    double M[3][3];
+    for(int r = 0; r<3; r++)
+        for(int k = 0; k<3; k++){
+            double sum = S[r][k];
+            for(int j = 0; j<3; j++)
+                sum += S[r][3 + j]*T[j][k];
+            M[r][k] = sum;
+        }
+    double C[3][3];
+    for(int k = 0; k<3; k++){
+        C[0][k] = M[2][k]/2;
+        C[1][k] = -M[1][k];
+        C[2][k] = M[0][k]/2;
+    }
+
+    // the ellipse is the eigenvector with 4ac - b^2 > 0
+    double tr = C[0][0] + C[1][1] + C[2][2];
+    double minors = C[0][0]*C[1][1] - C[0][1]*C[1][0] + C[0][0]*C[2][2] - C[0][2]*C[2][0]
+                  + C[1][1]*C[2][2] - C[1][2]*C[2][1];
+    double detC = C[0][0]*(C[1][1]*C[2][2] - C[1][2]*C[2][1])
+                - C[0][1]*(C[1][0]*C[2][2] - C[1][2]*C[2][0])
+                + C[0][2]*(C[1][0]*C[2][1] - C[1][1]*C[2][0]);
+    double roots[3];
+    int count = solve_cubic(-tr, minors, -detC, roots);
+    double best[3] = {0, 0, 0};
+    double best_cond = 0;
+    for(int k = 0; k<count; k++){
+        // the null vector of C - root I is the largest cross product of
+        // two of its rows
+        double R[3][3];
+        for(int r = 0; r<3; r++)
+            for(int j = 0; j<3; j++)
+                R[r][j] = C[r][j] - (r == j ? roots[k] : 0);
+        double v[3] = {0, 0, 0}, norm = 0;
+        for(int p = 0; p<3; p++){
+            const double *u = R[p], *w = R[(p + 1) % 3];
+            double x[3] = {u[1]*w[2] - u[2]*w[1], u[2]*w[0] - u[0]*w[2], u[0]*w[1] - u[1]*w[0]};
+            double n = x[0]*x[0] + x[1]*x[1] + x[2]*x[2];
+            if(n > norm){
+                norm = n;
+                v[0] = x[0];
+                v[1] = x[1];
+                v[2] = x[2];
+            }
+        }
+        if(norm == 0)
+            continue;
+        norm = sqrt(norm);
+        for(int j = 0; j<3; j++)
+            v[j] /= norm;
+        double cond = 4*v[0]*v[2] - v[1]*v[1];
+        if(cond > best_cond){
+            best_cond = cond;
+            for(int j = 0; j<3; j++)
+                best[j] = v[j];
+        }
+    }
+    if(best_cond <= 0)
+        return false;
+
+    // conic A x^2 + B xy + C y^2 + D x + E y + F = 0 in normalized units
+    double conic[6] = {best[0], best[1], best[2], 0, 0, 0};
+    for(int k = 0; k<3; k++)
+        conic[3 + k] = T[k][0]*best[0] + T[k][1]*best[1] + T[k][2]*best[2];
+    return conic_to_ellipse(conic, mo.cx, mo.cy, mo.scale, fit);
+}
+
+class ellipse_sums
+{
+public:
+    // a point (canvas pixels) was selected or deselected
+    void add(int64_t x, int64_t y){
+        if(n == 0){
+            ox = x;
+            oy = y;
+        }
+        accumulate(x-ox, y-oy, 1);
+        n++;
+    }
+    void remove(int64_t x, int64_t y){
+        accumulate(x-ox, y-oy, -1);
+        n--;
+        if(n == 0)
+            clear();
+    }
+    void clear(){
+        *this = ellipse_sums();
+    }
+
+    // the center of a cell of the view was selected or deselected
+    void add_cell(const grid_view& view, int x, int y){ add(view.center_x(x), view.center_y(y)); }
+    void remove_cell(const grid_view& view, int x, int y){ remove(view.center_x(x), view.center_y(y)); }
+
+    int64_t count() const { return n; }
+
+    // direct fit in canvas pixels; false with fewer than 6 points or when
+    // they do not determine an ellipse
+    bool solve(ellipse_params *fit) const {
+        if(n < 6)
+            return false;
+
+        // exact binomial shift of the sums to the pixel (ox + c, oy + d)
+        // nearest the centroid, in the same wrapping integer arithmetic
+        static const int binom[5][5] = {{1}, {1, 1}, {1, 2, 1}, {1, 3, 3, 1}, {1, 4, 6, 4, 1}};
+        int64_t c = (int64_t)llroundl((long double)(__int128)s[1][0]/n);
+        int64_t d = (int64_t)llroundl((long double)(__int128)s[0][1]/n);
+        unsigned __int128 pc[5] = {1}, pd[5] = {1};
+        for(int k = 1; k<5; k++){
+            pc[k] = pc[k-1]*(unsigned __int128)-c;
+            pd[k] = pd[k-1]*(unsigned __int128)-d;
+        }
+
+        // then means, the remaining sub-pixel shift to the centroid and the
+        // scaling to unit spread in long double
+        long double N = (long double)n;
+        long double raw[5][5];
+        for(int p = 0; p<5; p++)
+            for(int q = 0; p+q<5; q++){
+                unsigned __int128 sum = 0;
+                for(int i = 0; i<=p; i++)
+                    for(int j = 0; j<=q; j++)
+                        sum += (unsigned __int128)(binom[p][i]*binom[q][j])*pc[p-i]*pd[q-j]*s[i][j];
+                raw[p][q] = (long double)(__int128)sum/N;
+            }
+        long double a = raw[1][0], b = raw[0][1];
+        long double spread = raw[2][0] - a*a + raw[0][2] - b*b;
+        if(!(spread > 0))
+            return false;
+        long double scale = sqrtl(spread/2);
+
+        long double pa[5] = {1}, pb[5] = {1};
+        for(int k = 1; k<5; k++){
+            pa[k] = pa[k-1]*-a;
+            pb[k] = pb[k-1]*-b;
+        }
+        ellipse_moments mo;
+        for(int p = 0; p<5; p++)
+            for(int q = 0; q<5; q++){
+                if(p+q >= 5){
+                    mo.m[p][q] = 0;
+                    continue;
+                }
+                long double sum = 0;
+                for(int i = 0; i<=p; i++)
+                    for(int j = 0; j<=q; j++)
+                        sum += binom[p][i]*binom[q][j]*pa[p-i]*pb[q-j]*raw[i][j];
+                mo.m[p][q] = (double)(sum/powl(scale, p+q));
+            }
+        mo.cx = (double)(ox + c) + (double)a;
+        mo.cy = (double)(oy + d) + (double)b;
+        mo.scale = (double)scale;
+        return solve_ellipse_moments(mo, fit);
+    }
+
+private:
+    // sums wrap modulo 2^128, so a removal always undoes its add exactly
+    void accumulate(int64_t x, int64_t y, int sign){
+        unsigned __int128 X = (unsigned __int128)x;
+        unsigned __int128 term = sign < 0 ? -(unsigned __int128)1 : 1;
+        for(int p = 0; p<5; p++){
+            unsigned __int128 t = term;
+            for(int q = 0; p+q<5; q++){
+                s[p][q] += t;
+                t *= (unsigned __int128)y;
+            }
+            term *= X;
+        }
+    }
+
+    int64_t n = 0;
+    int64_t ox = 0;
+    int64_t oy = 0;
+    unsigned __int128 s[5][5] = {};
+};
+
+// direct fit to n points given as arrays of any numeric type: one pass for
+// the centroid and spread, one for the normalized moments
+template<class T>
+inline bool fit_ellipse_points(const T *xs, const T *ys, size_t n, ellipse_params *fit){
+    if(n < 6)
+        return false;
+    double mx = 0, my = 0;
+    for(size_t k = 0; k<n; k++){
+        mx += xs[k];
+        my += ys[k];
+    }
+    mx /= n;
+    my /= n;
+    double spread = 0;
+    for(size_t k = 0; k<n; k++)
+        spread += (xs[k]-mx)*(xs[k]-mx) + (ys[k]-my)*(ys[k]-my);
+    if(!(spread > 0))
+        return false;
+
+    ellipse_moments mo = {};
+    mo.cx = mx;
+    mo.cy = my;
+    mo.scale = sqrt(spread/(2*n));
+    for(size_t k = 0; k<n; k++){
+        double X = (xs[k]-mx)/mo.scale, Y = (ys[k]-my)/mo.scale;
+        double xp = 1;
+        for(int p = 0; p<5; p++){
+            double term = xp;
+            for(int q = 0; p+q<5; q++){
+                mo.m[p][q] += term;
+                term *= Y;
+            }
+            xp *= X;
+        }
+    }
+    for(int p = 0; p<5; p++)
+        for(int q = 0; p+q<5; q++)
+            mo.m[p][q] /= n;
+    return solve_ellipse_moments(mo, fit);
+}
+
+#endif
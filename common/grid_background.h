@@ -0,0 +1,78 @@
+#ifndef COMMON_GRID_BACKGROUND_H
+#define COMMON_GRID_BACKGROUND_H
+
+// The gray-dot background of the grid. Every dotted pixel row of the
+// viewport is identical, so one dot row is built and block-copied into
+// place. The result is cached per layout and color: resets and new
+// windows with the same grid reuse it instead of rebuilding it.
+
+#include <string.h>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <opencv2/opencv.hpp>
+#include "grid_view.h"
+#include "thread_pool.h"
+
+// the background only depends on these; the viewport origin does not
+// matter since scrolling never shows cells past the edge of the grid
+typedef std::tuple<int, int, int, int, int, int, int> background_key;
+
+inline background_key make_background_key(const grid_view& view, cv::Vec3b color){
+    int packed = color[0] | color[1] << 8 | color[2] << 16;
+    return background_key(view.point_size, view.patch_size, view.cols, view.rows, view.width, view.height, packed);
+}
+
+inline cv::Mat build_grid_background(const grid_view& view, cv::Vec3b color){
+
+    cv::Mat background(view.height, view.width, CV_8UC3, cv::Scalar(255, 255, 255));
+
+    // one row through the dots of every visible column
+    cv::Mat dot_row(1, view.width, CV_8UC3, cv::Scalar(255, 255, 255));
+    for(int i = 0; i<view.width; i++){
+        if(i%view.patch_size<view.point_size && view.contains(view.cell_x(i), view.origin_y))
+            dot_row.at<cv::Vec3b>(0, i) = color;
+    }
+
+    // copy it into the dotted rows, the blank rows are left white
+    size_t bytes = (size_t)view.width*sizeof(cv::Vec3b);
+    const unsigned char *dots = dot_row.ptr<unsigned char>(0);
+    parallel::parallel_for(0, view.height, parallel::tile_size, [&](int64_t begin, int64_t end){
+        for(int64_t j = begin; j<end; j++){
+            if(j%view.patch_size<view.point_size && view.contains(view.origin_x, view.cell_y((int)j)))
+                memcpy(background.ptr<unsigned char>((int)j), dots, bytes);
+        }
+    });
+    return background;
+}
+
+// cached backgrounds, shared by every window of the process
+inline cv::Mat cached_grid_background(const grid_view& view, cv::Vec3b color){
+
+    static std::mutex lock;
+    static std::map<background_key, cv::Mat> cache;
+    const size_t max_entries = 16;
+
+    background_key key = make_background_key(view, color);
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        auto it = cache.find(key);
+        if(it != cache.end())
+            return it->second;
+    }
+    cv::Mat background = build_grid_background(view, color);
+    std::lock_guard<std::mutex> guard(lock);
+    if(cache.size() >= max_entries)
+        cache.clear();
+    cache[key] = background;
+    return background;
+}
+
+// paint the dots of the grid cells visible in the viewport onto the top
+// view.height x view.width pixels of src
+inline void draw_grid_background(cv::Mat *src, const grid_view& view, cv::Vec3b color){
+    cv::Mat region = (*src)(cv::Rect(0, 0, view.width, view.height));
+    cached_grid_background(view, color).copyTo(region);
+}
+
+#endif
@@ -0,0 +1,235 @@
+#ifndef COMMON_GRID_VIEW_H
+#define COMMON_GRID_VIEW_H
+
+// Geometry of the dotted grid shared by the apps. The grid can be far
+// larger than the window: only a viewport of it is rendered, and selection
+// state lives in a cell_set whose memory follows the selected region
+// rather than the canvas area.
+//
+// Three coordinate systems are used:
+//   cell      grid index (x, y), 0 <= x < cols, 0 <= y < rows
+//   canvas    pixel of the full-resolution grid, never allocated
+//   viewport  pixel of the window frame, canvas minus the viewport origin
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <map>
+
+struct grid_view {
+    int cols;
+    int rows;
+    int point_size;
+    int patch_size;
+
+    // viewport size in pixels and its first visible cell
+    int width;
+    int height;
+    int origin_x;
+    int origin_y;
+
+    bool contains(int x, int y) const {
+        return x>=0 && x<cols && y>=0 && y<rows;
+    }
+
+    // cell under a viewport pixel
+    int cell_x(int px) const { return origin_x + px/patch_size; }
+    int cell_y(int py) const { return origin_y + py/patch_size; }
+
+    // viewport pixel of the top-left corner of a cell
+    int pixel_x(int x) const { return (x-origin_x)*patch_size; }
+    int pixel_y(int y) const { return (y-origin_y)*patch_size; }
+
+    // whether the dot of a cell lies entirely inside the viewport
+    bool visible(int x, int y) const {
+        int px = pixel_x(x);
+        int py = pixel_y(y);
+        return contains(x, y) && px>=0 && py>=0 && px+point_size<=width && py+point_size<=height;
+    }
+
+    // canvas pixel at the middle of a cell's dot, where fits are computed
+    int64_t center_x(int x) const { return (int64_t)x*patch_size + (point_size+1)/2; }
+    int64_t center_y(int y) const { return (int64_t)y*patch_size + (point_size+1)/2; }
+
+    // canvas position of the viewport's top-left pixel
+    int64_t offset_x() const { return (int64_t)origin_x*patch_size; }
+    int64_t offset_y() const { return (int64_t)origin_y*patch_size; }
+
+    // move the viewport by whole cells, keeping it on the grid
+    void scroll(int dx, int dy){
+        int max_x = std::max(0, cols - width/patch_size);
+        int max_y = std::max(0, rows - height/patch_size);
+        origin_x = std::min(std::max(origin_x+dx, 0), max_x);
+        origin_y = std::min(std::max(origin_y+dy, 0), max_y);
+    }
+};
+
+// a viewport of max_cells x max_cells cells onto a cols x rows grid; grids
+// smaller than the viewport leave its remainder blank
+inline grid_view make_grid_view(int cols, int rows, int point_size, int max_cells = 20){
+    grid_view view;
+    view.cols = cols;
+    view.rows = rows;
+    view.point_size = point_size;
+    view.patch_size = 3*point_size;
+    view.width = max_cells*view.patch_size;
+    view.height = max_cells*view.patch_size;
+    view.origin_x = 0;
+    view.origin_y = 0;
+    return view;
+}
+
+// scroll half a viewport with the w/a/s/d keys; returns whether the key
+// was a scroll key
+inline bool scroll_key(grid_view *view, int key){
+    int step_x = std::max(1, view->width/view->patch_size/2);
+    int step_y = std::max(1, view->height/view->patch_size/2);
+    switch(key){
+    case 'a': view->scroll(-step_x, 0); return true;
+    case 'd': view->scroll(step_x, 0); return true;
+    case 'w': view->scroll(0, -step_y); return true;
+    case 's': view->scroll(0, step_y); return true;
+    default: return false;
+    }
+}
+
+// parse "[cols [rows]]" from the command line, 20x20 by default
+inline bool grid_size_args(int argc, char **argv, int *cols, int *rows){
+    *cols = argc > 1 ? atoi(argv[1]) : 20;
+    *rows = argc > 2 ? atoi(argv[2]) : *cols;
+    return *cols > 0 && *rows > 0;
+}
+
+// sparse set of selected cells, bit-packed: the grid is split into 64x64
+// cell tiles and only tiles holding a selected cell are allocated, one
+// 64-bit word per tile row. Walking the set scans words with count
+// trailing zeros, and rectangles are set, cleared or toggled a word at a
+// time.
+class cell_set
+{
+public:
+    bool contains(int x, int y) const {
+        auto it = tiles.find(tile_key(x, y));
+        return it != tiles.end() && (it->second.rows[y & 63] >> (x & 63) & 1);
+    }
+    void insert(int x, int y) { set_rect(x, y, x+1, y+1); }
+    void erase(int x, int y) { clear_rect(x, y, x+1, y+1); }
+
+    // flip a cell and return whether it is now selected
+    bool toggle(int x, int y){
+        toggle_rect(x, y, x+1, y+1);
+        return contains(x, y);
+    }
+
+    void clear() { tiles.clear(); count = 0; }
+    size_t size() const { return count; }
+
+    // select, deselect or flip every cell of [x0, x1) x [y0, y1)
+    void set_rect(int x0, int y0, int x1, int y1) { apply(x0, y0, x1, y1, SET); }
+    void clear_rect(int x0, int y0, int x1, int y1) { apply(x0, y0, x1, y1, CLEAR); }
+    void toggle_rect(int x0, int y0, int x1, int y1) { apply(x0, y0, x1, y1, TOGGLE); }
+
+    // call f(x, y) for every selected cell, tile by tile in row-major tile
+    // order and row-major within a tile
+    template<class F>
+    void for_each(F f) const {
+        for(auto it = tiles.begin(); it != tiles.end(); ++it)
+            walk(it->first, it->second, 0, 64, ~(uint64_t)0, f);
+    }
+
+    // same, only for the cells inside [x0, x1) x [y0, y1); only the tiles
+    // overlapping the rectangle are visited
+    template<class F>
+    void for_each_in_rect(int x0, int y0, int x1, int y1, F f) const {
+        if(x1 <= x0 || y1 <= y0)
+            return;
+        for(int ty = y0 >> 6; ty <= (y1-1) >> 6; ty++){
+            for(int tx = x0 >> 6; tx <= (x1-1) >> 6; tx++){
+                int64_t key = make_key(tx, ty);
+                auto it = tiles.find(key);
+                if(it == tiles.end())
+                    continue;
+                int row0 = std::max(y0 - ty*64, 0);
+                int row1 = std::min(y1 - ty*64, 64);
+                walk(key, it->second, row0, row1, span_mask(std::max(x0 - tx*64, 0), std::min(x1 - tx*64, 64)), f);
+            }
+        }
+    }
+
+private:
+    enum op { SET, CLEAR, TOGGLE };
+
+    struct tile {
+        uint64_t rows[64];
+        int count;
+    };
+
+    static int64_t make_key(int tx, int ty) { return ((int64_t)ty << 32) | (uint32_t)tx; }
+    static int64_t tile_key(int x, int y) { return make_key(x >> 6, y >> 6); }
+
+    // bits [b0, b1) of a word
+    static uint64_t span_mask(int b0, int b1){
+        uint64_t upper = b1 >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << b1) - 1;
+        return upper & ~(((uint64_t)1 << b0) - 1);
+    }
+
+    template<class F>
+    static void walk(int64_t key, const tile& t, int row0, int row1, uint64_t columns, F& f){
+        int base_x = (int)(uint32_t)(key & 0xffffffff)*64;
+        int base_y = (int)(key >> 32)*64;
+        for(int r = row0; r<row1; r++){
+            uint64_t bits = t.rows[r] & columns;
+            while(bits){
+                f(base_x + __builtin_ctzll(bits), base_y + r);
+                bits &= bits - 1;
+            }
+        }
+    }
+
+    void apply(int x0, int y0, int x1, int y1, op action){
+        if(x1 <= x0 || y1 <= y0)
+            return;
+        for(int ty = y0 >> 6; ty <= (y1-1) >> 6; ty++){
+            for(int tx = x0 >> 6; tx <= (x1-1) >> 6; tx++){
+                int64_t key = make_key(tx, ty);
+                auto it = tiles.find(key);
+                if(it == tiles.end()){
+                    if(action == CLEAR)
+                        continue;
+                    it = tiles.emplace(key, tile()).first;
+                    std::fill(it->second.rows, it->second.rows + 64, 0);
+                    it->second.count = 0;
+                }
+                tile& t = it->second;
+                uint64_t columns = span_mask(std::max(x0 - tx*64, 0), std::min(x1 - tx*64, 64));
+                int row1 = std::min(y1 - ty*64, 64);
+                for(int r = std::max(y0 - ty*64, 0); r<row1; r++){
+                    uint64_t before = t.rows[r];
+                    if(action == SET)
+                        t.rows[r] |= columns;
+                    else if(action == CLEAR)
+                        t.rows[r] &= ~columns;
+                    else
+                        t.rows[r] ^= columns;
+                    int delta = __builtin_popcountll(t.rows[r]) - __builtin_popcountll(before);
+                    t.count += delta;
+                    count += delta;
+                }
+                if(t.count == 0)
+                    tiles.erase(it);
+            }
+        }
+    }
+
+    std::map<int64_t, tile> tiles;
+    size_t count = 0;
+};
+
+// call f(x, y) for the selected cells inside the viewport
+template<class F>
+inline void for_each_visible(const cell_set& selected, const grid_view& view, F f){
+    selected.for_each_in_rect(view.origin_x, view.origin_y, view.origin_x + view.width/view.patch_size + 1,
+                              view.origin_y + view.height/view.patch_size + 1, f);
+}
+
+#endif
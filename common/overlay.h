@@ -0,0 +1,105 @@
+#ifndef COMMON_OVERLAY_H
+#define COMMON_OVERLAY_H
+
+// Sparse overlay on top of the static grid layer. The frame shown in the
+// window is the grid background with the overlay (selected cells, fitted
+// curves) drawn over it; the overlay keeps a list of what it covers so a
+// reset or redraw only restores those pixels from the background instead
+// of copying the whole frame. Cells are kept once each, so repainting the
+// same cells does not grow the list.
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "grid_view.h"
+#include "ring_kernel.h"
+
+class overlay
+{
+public:
+    // a rectangle of viewport pixels was drawn over
+    void add_rect(cv::Rect rect){
+        items.push_back(item{rect, 0, 0, 0, 0, false});
+    }
+
+    // the dot of a cell was drawn over; a cell painted again, e.g. when it
+    // is deselected or an edit is undone, keeps its single entry
+    void add_cell(const grid_view& view, int x, int y){
+        if(view.visible(x, y))
+            cells[(int64_t)x << 32 | (uint32_t)y] = cv::Rect(view.pixel_x(x), view.pixel_y(y), view.point_size, view.point_size);
+    }
+
+    // the band |d - radius| < half_width around a viewport pixel was drawn over
+    void add_ring(int cx, int cy, double radius, double half_width){
+        items.push_back(item{cv::Rect(), cx, cy, radius, half_width, true});
+    }
+
+    // drop the entry of a rect or ring the caller has restored itself
+    void forget_rect(cv::Rect rect){
+        forget(item{rect, 0, 0, 0, 0, false});
+    }
+    void forget_ring(int cx, int cy, double radius, double half_width){
+        forget(item{cv::Rect(), cx, cy, radius, half_width, true});
+    }
+
+    bool empty() const { return items.empty() && cells.empty(); }
+    size_t size() const { return items.size() + cells.size(); }
+
+    // restore the background under every item and forget them
+    void clear(cv::Mat *frame, const cv::Mat& background){
+        cv::Rect bounds(0, 0, (*frame).cols, (*frame).rows);
+        auto restore_rect = [&](cv::Rect rect){
+            rect &= bounds;
+            if(rect.area() > 0){
+                cv::Mat region = (*frame)(rect);
+                background(rect).copyTo(region);
+            }
+        };
+        for(size_t k = 0; k<items.size(); k++){
+            const item& it = items[k];
+            if(it.ring){
+                ring_kernel::for_each_in_ring_parallel((*frame).cols, (*frame).rows, it.cx, it.cy, it.radius, it.half_width,
+                    [frame, &background](int x, int y){
+                        (*frame).at<cv::Vec3b>(y, x) = background.at<cv::Vec3b>(y, x);
+                    });
+            }
+            else
+                restore_rect(it.rect);
+        }
+        for(auto it = cells.begin(); it != cells.end(); ++it)
+            restore_rect(it->second);
+        items.clear();
+        cells.clear();
+    }
+
+private:
+    struct item {
+        cv::Rect rect;
+        int cx;
+        int cy;
+        double radius;
+        double half_width;
+        bool ring;
+
+        bool operator==(const item& other) const {
+            return ring == other.ring && rect == other.rect && cx == other.cx && cy == other.cy &&
+                   radius == other.radius && half_width == other.half_width;
+        }
+    };
+
+    // the latest matching entry, most likely the one being replaced
+    void forget(const item& match){
+        for(size_t k = items.size(); k>0; k--){
+            if(items[k-1] == match){
+                items.erase(items.begin() + (k-1));
+                return;
+            }
+        }
+    }
+
+    std::vector<item> items;
+    std::unordered_map<int64_t, cv::Rect> cells;
+};
+
+#endif
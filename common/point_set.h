@@ -0,0 +1,106 @@
+#ifndef COMMON_POINT_SET_H
+#define COMMON_POINT_SET_H
+
+// Selected cells as a packed, duplicate-free point array for the fitters
+// that need the points themselves (cv::fitEllipse, RANSAC, clustering).
+//
+// The cell centers are stored contiguously in xs/ys, in canvas pixels, and
+// a hash index maps each cell to its slot. Insert appends, erase moves the
+// last point into the freed slot, so both are O(1) and the arrays never
+// have holes. Memory follows the number of distinct selected cells, not
+// the number of clicks.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+#include "grid_view.h"
+
+class point_set
+{
+public:
+    explicit point_set(const grid_view& layout) : layout(layout) {}
+
+    bool contains(int x, int y) const { return index.count(key(x, y)) != 0; }
+
+    // slot of a cell in xs/ys, or -1 when it is not in the set
+    int64_t slot(int x, int y) const {
+        auto it = index.find(key(x, y));
+        return it == index.end() ? -1 : (int64_t)it->second;
+    }
+
+    // add the center of a cell; false when it is already in the set
+    bool insert(int x, int y){
+        if(!index.emplace(key(x, y), point_xs.size()).second)
+            return false;
+        cells.push_back(cell{x, y});
+        point_xs.push_back((float)layout.center_x(x));
+        point_ys.push_back((float)layout.center_y(y));
+        return true;
+    }
+
+    // remove a cell, moving the last point into its slot; false when it
+    // was not in the set
+    bool erase(int x, int y){
+        auto it = index.find(key(x, y));
+        if(it == index.end())
+            return false;
+        size_t slot = it->second;
+        size_t last = point_xs.size() - 1;
+        index.erase(it);
+        if(slot != last){
+            cells[slot] = cells[last];
+            point_xs[slot] = point_xs[last];
+            point_ys[slot] = point_ys[last];
+            index[key(cells[slot].x, cells[slot].y)] = slot;
+        }
+        cells.pop_back();
+        point_xs.pop_back();
+        point_ys.pop_back();
+        return true;
+    }
+
+    void clear(){
+        index.clear();
+        cells.clear();
+        point_xs.clear();
+        point_ys.clear();
+    }
+
+    size_t size() const { return point_xs.size(); }
+
+    // cell centers in canvas pixels, in no particular order; float holds
+    // them exactly up to 2^24 pixels
+    const std::vector<float>& xs() const { return point_xs; }
+    const std::vector<float>& ys() const { return point_ys; }
+
+    // grid cell of point k
+    int cell_x(size_t k) const { return cells[k].x; }
+    int cell_y(size_t k) const { return cells[k].y; }
+
+private:
+    struct cell {
+        int x;
+        int y;
+    };
+
+    static int64_t key(int x, int y) { return (int64_t)x << 32 | (uint32_t)y; }
+
+    grid_view layout;
+    std::unordered_map<int64_t, size_t> index;
+    std::vector<cell> cells;
+    std::vector<float> point_xs;
+    std::vector<float> point_ys;
+};
+
+// call f(x, y) for the cells of the set inside the viewport
+template<class F>
+inline void for_each_visible(const point_set& points, const grid_view& view, F f){
+    for(size_t k = 0; k<points.size(); k++){
+        int x = points.cell_x(k), y = points.cell_y(k);
+        if(view.visible(x, y))
+            f(x, y);
+    }
+}
+
+#endif
@@ -0,0 +1,216 @@
+#ifndef COMMON_POINT_STREAM_H
+#define COMMON_POINT_STREAM_H
+
+// Streaming point-set input for the fitters, e.g. from stdin or a FIFO.
+//
+// The stream is text: one point per line, "x y" (commas are accepted as
+// separators), and a line "fit" ends the current set. Blank lines and lines
+// starting with '#' are skipped; points after the last "fit" form a final
+// set.
+//
+// A parser thread reads and parses the next chunk while the caller fits the
+// sets of the previous one. Sets are handed over in batches of complete
+// sets as soon as they arrive, so a slow pipe still gets a result per set
+// without waiting for more input. At most one batch waits for the caller;
+// sets finished while it waits are added to it, and the parser stops
+// reading once it is full, so memory stays bounded by the batch size (plus
+// one chunk and the largest single set).
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace point_stream {
+
+// complete sets parsed from the stream, laid out like point_sets in
+// q2_OO/batch_fit.h; first is the index of the first set in the stream
+struct batch {
+    uint64_t first = 0;
+    std::vector<uint64_t> offsets = std::vector<uint64_t>(1, 0);
+    std::vector<double> xs;
+    std::vector<double> ys;
+
+    size_t size() const { return offsets.size() - 1; }
+};
+
+class reader
+{
+public:
+    // points a batch collects before the parser waits for the caller
+    static const size_t batch_points = 1 << 20;
+
+    explicit reader(int fd, size_t chunk_bytes = 1 << 16) : fd(fd), chunk_bytes(chunk_bytes) {
+        parser = std::thread([this](){ parse_loop(); });
+    }
+
+    ~reader(){
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        changed.notify_all();
+        parser.join();
+    }
+
+    reader(const reader&) = delete;
+    reader& operator=(const reader&) = delete;
+
+    // wait for the next batch; false once the stream ended or failed
+    bool next(batch *out){
+        std::unique_lock<std::mutex> guard(lock);
+        changed.wait(guard, [&](){ return has_ready || finished; });
+        if(!has_ready)
+            return false;
+        std::swap(*out, ready);
+        has_ready = false;
+        changed.notify_all();
+        return true;
+    }
+
+    // empty unless the stream had a malformed line or a read error
+    std::string error(){
+        std::lock_guard<std::mutex> guard(lock);
+        return message;
+    }
+
+private:
+    void parse_loop(){
+        batch current;
+        std::string pending;
+        std::vector<char> chunk(chunk_bytes);
+        uint64_t line = 0;
+        uint64_t sets = 0;
+        std::string failure;
+
+        while(failure.empty()){
+            ssize_t got = ::read(fd, chunk.data(), chunk.size());
+            if(got < 0 && errno == EINTR)
+                continue;
+            if(got < 0){
+                failure = "read error";
+                break;
+            }
+            if(got == 0){
+                // a last line without a newline, then the open set
+                if(!pending.empty() && !parse_line(pending.c_str(), ++line, &current, &failure))
+                    break;
+                if(current.xs.size() > current.offsets.back())
+                    current.offsets.push_back(current.xs.size());
+                break;
+            }
+
+            // parse the complete lines, keep the tail for the next chunk
+            pending.append(chunk.data(), (size_t)got);
+            size_t start = 0;
+            for(size_t end = pending.find('\n'); end != std::string::npos; end = pending.find('\n', start)){
+                if(!parse_line(pending.c_str() + start, ++line, &current, &failure))
+                    break;
+                start = end + 1;
+            }
+            pending.erase(0, start);
+
+            if(current.size() > 0 && !hand_over(&current, &sets))
+                return;
+        }
+
+        if(current.size() > 0 && !hand_over(&current, &sets))
+            return;
+        std::lock_guard<std::mutex> guard(lock);
+        message = failure;
+        finished = true;
+        changed.notify_all();
+    }
+
+    // pass the complete sets of current to the caller, keeping the open set.
+    // If the caller still has not taken the last batch, the sets are added
+    // to it, so they do not wait for more input; once it holds batch_points
+    // points, wait for the caller instead. False when stopping.
+    bool hand_over(batch *current, uint64_t *sets){
+        std::unique_lock<std::mutex> guard(lock);
+        changed.wait(guard, [&](){ return !has_ready || ready.xs.size() < batch_points || stopping; });
+        if(stopping)
+            return false;
+
+        uint64_t done = current->offsets.back();
+        size_t count = current->size();
+        if(has_ready){
+            uint64_t base = ready.xs.size();
+            for(size_t k = 1; k<=count; k++)
+                ready.offsets.push_back(base + current->offsets[k]);
+            ready.xs.insert(ready.xs.end(), current->xs.begin(), current->xs.begin() + done);
+            ready.ys.insert(ready.ys.end(), current->ys.begin(), current->ys.begin() + done);
+            current->xs.erase(current->xs.begin(), current->xs.begin() + done);
+            current->ys.erase(current->ys.begin(), current->ys.begin() + done);
+            current->offsets.assign(1, 0);
+        }
+        else{
+            batch next;
+            next.xs.assign(current->xs.begin() + done, current->xs.end());
+            next.ys.assign(current->ys.begin() + done, current->ys.end());
+            current->xs.resize(done);
+            current->ys.resize(done);
+            ready.offsets.swap(current->offsets);
+            ready.xs.swap(current->xs);
+            ready.ys.swap(current->ys);
+            ready.first = *sets;
+            *current = std::move(next);
+        }
+        *sets += count;
+        has_ready = true;
+        changed.notify_all();
+        return true;
+    }
+
+    static bool line_end(char c) { return c == 0 || c == '\n' || c == '\r'; }
+
+    // parse one line, ended by '\n' or the end of the string
+    static bool parse_line(const char *p, uint64_t line, batch *current, std::string *failure){
+        while(*p == ' ' || *p == '\t')
+            p++;
+        if(line_end(*p) || *p == '#')
+            return true;
+        if(p[0] == 'f' && p[1] == 'i' && p[2] == 't' && (line_end(p[3]) || p[3] == ' ' || p[3] == '\t')){
+            current->offsets.push_back(current->xs.size());
+            return true;
+        }
+
+        double v[2];
+        for(int k = 0; k<2; k++){
+            while(*p == ' ' || *p == '\t' || *p == ',')
+                p++;
+            // strtod would skip the newline into the next line
+            char *next = (char*)p;
+            if(!line_end(*p))
+                v[k] = strtod(p, &next);
+            if(next == p){
+                *failure = "malformed point on line " + std::to_string(line);
+                return false;
+            }
+            p = next;
+        }
+        current->xs.push_back(v[0]);
+        current->ys.push_back(v[1]);
+        return true;
+    }
+
+    int fd;
+    size_t chunk_bytes;
+    std::thread parser;
+    std::mutex lock;
+    std::condition_variable changed;
+    batch ready;
+    bool has_ready = false;
+    bool finished = false;
+    bool stopping = false;
+    std::string message;
+};
+
+}
+
+#endif
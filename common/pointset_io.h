@@ -0,0 +1,167 @@
+#ifndef COMMON_POINTSET_IO_H
+#define COMMON_POINTSET_IO_H
+
+// Binary point-set files, read through mmap with no parsing or copy.
+//
+// Layout (little-endian, every section 8-byte aligned):
+//
+//   header    32 bytes: magic "PSET", version, coordinate type,
+//             reserved word, set count, point count
+//   offsets   (set count + 1) uint64; set k holds the points
+//             offsets[k] <= i < offsets[k+1]
+//   xs        point count coordinates, int32 or float32
+//   ys        point count coordinates, same type, padded to 8 bytes
+//
+// The coordinates are stored as two arrays, like point_sets in
+// q2_OO/batch_fit.h, so a fitter can walk them straight from the mapping.
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+namespace pointset_io {
+
+enum coord_type { COORD_INT32 = 0, COORD_FLOAT32 = 1 };
+
+struct header {
+    char magic[4];
+    uint32_t version;
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t set_count;
+    uint64_t point_count;
+};
+
+const uint32_t current_version = 1;
+
+inline uint64_t align8(uint64_t bytes) { return (bytes + 7) & ~(uint64_t)7; }
+
+// byte offsets of the sections of a file with the given counts
+inline uint64_t offsets_at() { return sizeof(header); }
+inline uint64_t xs_at(uint64_t sets) { return offsets_at() + 8*(sets + 1); }
+inline uint64_t ys_at(uint64_t sets, uint64_t points) { return xs_at(sets) + align8(4*points); }
+inline uint64_t file_size(uint64_t sets, uint64_t points) { return ys_at(sets, points) + align8(4*points); }
+
+// read-only view of a mapped point-set file
+class mapped_sets
+{
+public:
+    mapped_sets() {}
+    ~mapped_sets() { close(); }
+    mapped_sets(const mapped_sets&) = delete;
+    mapped_sets& operator=(const mapped_sets&) = delete;
+
+    // map a file and check its header and offsets table; on failure the
+    // reason is left in error()
+    bool open(const char *path){
+        close();
+        int fd = ::open(path, O_RDONLY);
+        if(fd < 0)
+            return fail(std::string("cannot open ") + path);
+        struct stat st;
+        if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(header)){
+            ::close(fd);
+            return fail("file too small for a header");
+        }
+        bytes = (size_t)st.st_size;
+        void *p = mmap(NULL, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if(p == MAP_FAILED){
+            bytes = 0;
+            return fail("mmap failed");
+        }
+        base = (const unsigned char*)p;
+
+        // the fitters walk the file front to back
+        madvise(p, bytes, MADV_SEQUENTIAL);
+
+        const header& h = *(const header*)base;
+        if(memcmp(h.magic, "PSET", 4) != 0)
+            return fail("not a point-set file");
+        if(h.version != current_version)
+            return fail("unsupported version");
+        if(h.type != COORD_INT32 && h.type != COORD_FLOAT32)
+            return fail("unknown coordinate type");
+        if(h.set_count > bytes/8 || h.point_count > bytes/4 || file_size(h.set_count, h.point_count) > bytes)
+            return fail("file truncated");
+        const uint64_t *off = offsets();
+        if(off[0] != 0 || off[h.set_count] != h.point_count)
+            return fail("bad offsets table");
+        for(uint64_t k = 0; k<h.set_count; k++){
+            if(off[k] > off[k+1])
+                return fail("bad offsets table");
+        }
+        return true;
+    }
+
+    void close(){
+        if(base != NULL)
+            munmap((void*)base, bytes);
+        base = NULL;
+        bytes = 0;
+    }
+
+    bool is_open() const { return base != NULL; }
+    const std::string& error() const { return message; }
+
+    coord_type type() const { return (coord_type)head().type; }
+    uint64_t set_count() const { return head().set_count; }
+    uint64_t point_count() const { return head().point_count; }
+    const uint64_t *offsets() const { return (const uint64_t*)(base + offsets_at()); }
+
+    // coordinate arrays; T must match type()
+    template<class T>
+    const T *xs() const { return (const T*)(base + xs_at(set_count())); }
+    template<class T>
+    const T *ys() const { return (const T*)(base + ys_at(set_count(), point_count())); }
+
+private:
+    const header& head() const { return *(const header*)base; }
+
+    bool fail(const std::string& why){
+        close();
+        message = why;
+        return false;
+    }
+
+    const unsigned char *base = NULL;
+    size_t bytes = 0;
+    std::string message;
+};
+
+// write sets given as an offsets table and two coordinate arrays of
+// int32_t or float
+template<class T>
+inline bool write_sets(const char *path, const std::vector<uint64_t>& offsets, const std::vector<T>& xs, const std::vector<T>& ys){
+    static_assert(sizeof(T) == 4, "coordinates are 32 bits");
+    if(offsets.empty() || xs.size() != ys.size() || offsets.back() != xs.size())
+        return false;
+    header h;
+    memcpy(h.magic, "PSET", 4);
+    h.version = current_version;
+    h.type = (T)0.5 == 0 ? COORD_INT32 : COORD_FLOAT32;
+    h.reserved = 0;
+    h.set_count = offsets.size() - 1;
+    h.point_count = xs.size();
+
+    FILE *out = fopen(path, "wb");
+    if(out == NULL)
+        return false;
+    const char zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    size_t pad = (size_t)(align8(4*h.point_count) - 4*h.point_count);
+    bool ok = fwrite(&h, sizeof(h), 1, out) == 1 &&
+              fwrite(offsets.data(), 8, offsets.size(), out) == offsets.size() &&
+              fwrite(xs.data(), 4, xs.size(), out) == xs.size() && fwrite(zeros, 1, pad, out) == pad &&
+              fwrite(ys.data(), 4, ys.size(), out) == ys.size() && fwrite(zeros, 1, pad, out) == pad;
+    return fclose(out) == 0 && ok;
+}
+
+}
+
+#endif
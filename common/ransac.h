@@ -0,0 +1,393 @@
+#ifndef COMMON_RANSAC_H
+#define COMMON_RANSAC_H
+
+// RANSAC circle fit for point sets with outliers. Hypotheses are circles
+// through 3 random points; they are drawn in rounds and scored in parallel
+// on the shared thread pool, each by counting the points within
+// `threshold` of the circle. The count uses the same squared-distance band
+// as the ring kernel, (r-t)^2 < d^2 < (r+t)^2, 8 or 4 points per
+// instruction. The loop stops once enough rounds have run to have drawn an
+// all-inlier sample with the requested confidence, and the best circle is
+// then refined by Taubin fits of its inliers (LO-RANSAC).
+//
+// Every hypothesis draws its sample from its own generator seeded by
+// (seed, hypothesis index), and ties go to the lowest index, so the result
+// only depends on the seed and never on the number of threads.
+
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+#include "circle_fit.h"
+#include "ring_kernel.h"
+#include "thread_pool.h"
+
+namespace ransac {
+
+struct options {
+    double threshold = 1.5;     // inlier distance from the circle, pixels
+    double confidence = 0.99;   // chance of having drawn one clean sample
+    int max_iterations = 10000;
+    int round = 64;             // hypotheses scored per round
+    uint64_t seed = 1;
+    int refine_steps = 2;
+};
+
+struct circle_result {
+    bool found = false;
+    double cx = 0;
+    double cy = 0;
+    double radius = 0;
+    std::vector<uint8_t> inliers;   // 1 for every inlier, in input order
+    size_t inlier_count = 0;
+    int iterations = 0;
+};
+
+inline uint64_t splitmix64(uint64_t *state){
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30))*0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27))*0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+// number of points with lo < (x-cx)^2 + (y-cy)^2 < hi; sets mask[k] to
+// 0/1 for every point when mask is not NULL
+inline size_t count_in_band_scalar(const float *xs, const float *ys, size_t n, float cx, float cy, float lo, float hi,
+                                   uint8_t *mask){
+    size_t count = 0;
+    for(size_t k = 0; k<n; k++){
+        float dx = xs[k] - cx;
+        float dy = ys[k] - cy;
+        float d2 = dx*dx + dy*dy;
+        uint8_t in = d2 > lo && d2 < hi;
+        if(mask != NULL)
+            mask[k] = in;
+        count += in;
+    }
+    return count;
+}
+
+#ifdef RING_KERNEL_X86
+
+__attribute__((target("avx2")))
+inline size_t count_in_band_avx2(const float *xs, const float *ys, size_t n, float cx, float cy, float lo, float hi){
+    __m256 vcx = _mm256_set1_ps(cx);
+    __m256 vcy = _mm256_set1_ps(cy);
+    __m256 vlo = _mm256_set1_ps(lo);
+    __m256 vhi = _mm256_set1_ps(hi);
+    size_t count = 0;
+    size_t k = 0;
+    for(; k+8<=n; k += 8){
+        __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(xs+k), vcx);
+        __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(ys+k), vcy);
+        __m256 d2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+        __m256 in = _mm256_and_ps(_mm256_cmp_ps(d2, vlo, _CMP_GT_OQ), _mm256_cmp_ps(d2, vhi, _CMP_LT_OQ));
+        count += __builtin_popcount(_mm256_movemask_ps(in));
+    }
+    return count + count_in_band_scalar(xs+k, ys+k, n-k, cx, cy, lo, hi, NULL);
+}
+
+__attribute__((target("sse2")))
+inline size_t count_in_band_sse2(const float *xs, const float *ys, size_t n, float cx, float cy, float lo, float hi){
+    __m128 vcx = _mm_set1_ps(cx);
+    __m128 vcy = _mm_set1_ps(cy);
+    __m128 vlo = _mm_set1_ps(lo);
+    __m128 vhi = _mm_set1_ps(hi);
+    size_t count = 0;
+    size_t k = 0;
+    for(; k+4<=n; k += 4){
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(xs+k), vcx);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(ys+k), vcy);
+        __m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+        __m128 in = _mm_and_ps(_mm_cmpgt_ps(d2, vlo), _mm_cmplt_ps(d2, vhi));
+        count += __builtin_popcount(_mm_movemask_ps(in));
+    }
+    return count + count_in_band_scalar(xs+k, ys+k, n-k, cx, cy, lo, hi, NULL);
+}
+
+#endif
+
+inline size_t count_in_band(const float *xs, const float *ys, size_t n, float cx, float cy, float lo, float hi){
+#ifdef RING_KERNEL_X86
+    switch(ring_kernel::active_isa()){
+    case ring_kernel::ISA_AVX2:
+        return count_in_band_avx2(xs, ys, n, cx, cy, lo, hi);
+    case ring_kernel::ISA_SSE2:
+        return count_in_band_sse2(xs, ys, n, cx, cy, lo, hi);
+    default:
+        break;
+    }
+#endif
+    return count_in_band_scalar(xs, ys, n, cx, cy, lo, hi, NULL);
+}
+
+// squared-distance band of a circle, widened by the threshold
+inline void band(double radius, double threshold, float *lo, float *hi){
+    double inner = std::max(radius - threshold, 0.);
+    *lo = radius > threshold ? (float)(inner*inner) : -1.f;
+    *hi = (float)((radius + threshold)*(radius + threshold));
+}
+
+// circle through three points; false when they are (nearly) collinear
+inline bool circle_through(double x1, double y1, double x2, double y2, double x3, double y3,
+                           double *cx, double *cy, double *radius){
+    double bx = x2 - x1, by = y2 - y1;
+    double qx = x3 - x1, qy = y3 - y1;
+    double d = 2*(bx*qy - by*qx);
+    double b2 = bx*bx + by*by;
+    double q2 = qx*qx + qy*qy;
+    if(fabs(d) <= 1e-9*(b2 + q2))
+        return false;
+    double ux = (qy*b2 - by*q2)/d;
+    double uy = (bx*q2 - qx*b2)/d;
+    *cx = x1 + ux;
+    *cy = y1 + uy;
+    *radius = sqrt(ux*ux + uy*uy);
+    return true;
+}
+
+// points per task for the passes over every point; fixed, so partial
+// sums are always combined in the same order
+const int64_t chunk = 1 << 16;
+
+// set mask[k] for every point inside the band and return their number
+inline size_t mark_in_band(const std::vector<float>& xs, const std::vector<float>& ys, float cx, float cy, float lo, float hi,
+                           std::vector<uint8_t> *mask){
+    int64_t n = (int64_t)xs.size();
+    std::vector<size_t> counts((n + chunk - 1)/chunk);
+    parallel::parallel_for(0, n, chunk, [&](int64_t begin, int64_t end){
+        counts[begin/chunk] = count_in_band_scalar(xs.data()+begin, ys.data()+begin, end-begin, cx, cy, lo, hi, mask->data()+begin);
+    });
+    size_t total = 0;
+    for(size_t c = 0; c<counts.size(); c++)
+        total += counts[c];
+    return total;
+}
+
+// Taubin fit of the points selected by mask, about their centroid
+inline bool refit(const std::vector<float>& xs, const std::vector<float>& ys, const std::vector<uint8_t>& mask,
+                  double *cx, double *cy, double *radius){
+    int64_t n = (int64_t)xs.size();
+    int64_t chunks = (n + chunk - 1)/chunk;
+
+    // centroid of the inliers
+    std::vector<double> part(3*chunks, 0.);
+    parallel::parallel_for(0, n, chunk, [&](int64_t begin, int64_t end){
+        double *p = &part[3*(begin/chunk)];
+        for(int64_t k = begin; k<end; k++){
+            if(mask[k]){
+                p[0]++;
+                p[1] += xs[k];
+                p[2] += ys[k];
+            }
+        }
+    });
+    double count = 0, mx = 0, my = 0;
+    for(int64_t c = 0; c<chunks; c++){
+        count += part[3*c];
+        mx += part[3*c+1];
+        my += part[3*c+2];
+    }
+    if(count < 3)
+        return false;
+    mx /= count;
+    my /= count;
+
+    // moments about it
+    std::vector<circle_moments> parts(chunks, circle_moments{0, 0, 0, 0, 0, 0});
+    parallel::parallel_for(0, n, chunk, [&](int64_t begin, int64_t end){
+        circle_moments& m = parts[begin/chunk];
+        for(int64_t k = begin; k<end; k++){
+            if(mask[k]){
+                double x = xs[k] - mx;
+                double y = ys[k] - my;
+                double z = x*x + y*y;
+                m.Mxx += x*x;
+                m.Myy += y*y;
+                m.Mxy += x*y;
+                m.Mxz += x*z;
+                m.Myz += y*z;
+                m.Mzz += z*z;
+            }
+        }
+    });
+    circle_moments m = {0, 0, 0, 0, 0, 0};
+    for(int64_t c = 0; c<chunks; c++){
+        m.Mxx += parts[c].Mxx/count; m.Myy += parts[c].Myy/count; m.Mxy += parts[c].Mxy/count;
+        m.Mxz += parts[c].Mxz/count; m.Myz += parts[c].Myz/count; m.Mzz += parts[c].Mzz/count;
+    }
+    double dx, dy;
+    if(!solve_circle_moments(circle_taubin, m, &dx, &dy, radius))
+        return false;
+    *cx = mx + dx;
+    *cy = my + dy;
+    return true;
+}
+
+// fit a circle to the points (xs[k], ys[k])
+inline circle_result fit_circle(const std::vector<float>& in_xs, const std::vector<float>& in_ys, const options& opt = options()){
+
+    circle_result result;
+    size_t n = std::min(in_xs.size(), in_ys.size());
+    if(n < 3)
+        return result;
+
+    // work about the mean so float distances keep their precision on large
+    // canvases
+    double ox = 0, oy = 0;
+    for(size_t k = 0; k<n; k++){
+        ox += in_xs[k];
+        oy += in_ys[k];
+    }
+    ox /= n;
+    oy /= n;
+    std::vector<float> xs(n), ys(n);
+    for(size_t k = 0; k<n; k++){
+        xs[k] = (float)(in_xs[k] - ox);
+        ys[k] = (float)(in_ys[k] - oy);
+    }
+
+    struct hypothesis {
+        double cx, cy, radius;
+        int64_t score;
+    };
+    std::vector<hypothesis> round(std::max(opt.round, 1));
+    hypothesis best = {0, 0, 0, -1};
+    int64_t required = opt.max_iterations;
+    int iterations = 0;
+
+    while(iterations < required && iterations < opt.max_iterations){
+        int first = iterations;
+        int count = (int)std::min<int64_t>(round.size(), std::min<int64_t>(required, opt.max_iterations) - iterations);
+        parallel::parallel_for(0, count, 1, [&](int64_t begin, int64_t end){
+            for(int64_t h = begin; h<end; h++){
+                hypothesis& hyp = round[h];
+                hyp.score = -1;
+                uint64_t state = opt.seed*0x9e3779b97f4a7c15ull + (uint64_t)(first + h);
+                size_t pick[3];
+                for(int s = 0; s<3; s++){
+                    bool repeated;
+                    do{
+                        pick[s] = (size_t)(((splitmix64(&state) >> 32)*(uint64_t)n) >> 32);
+                        repeated = false;
+                        for(int t = 0; t<s; t++)
+                            repeated |= pick[t] == pick[s];
+                    } while(repeated);
+                }
+                if(!circle_through(xs[pick[0]], ys[pick[0]], xs[pick[1]], ys[pick[1]], xs[pick[2]], ys[pick[2]],
+                                   &hyp.cx, &hyp.cy, &hyp.radius))
+                    continue;
+                float lo, hi;
+                band(hyp.radius, opt.threshold, &lo, &hi);
+                hyp.score = (int64_t)count_in_band(xs.data(), ys.data(), n, (float)hyp.cx, (float)hyp.cy, lo, hi);
+            }
+        });
+        iterations += count;
+
+        // best so far, earliest hypothesis on ties
+        for(int h = 0; h<count; h++){
+            if(round[h].score > best.score)
+                best = round[h];
+        }
+
+        // rounds needed for a clean 3-point sample given the inlier ratio
+        if(best.score > 0){
+            double w = (double)best.score/n;
+            double clean = w*w*w;
+            if(clean >= 1)
+                required = iterations;
+            else if(clean > 0)
+                required = std::min<int64_t>(opt.max_iterations,
+                    (int64_t)ceil(log(1 - opt.confidence)/log(1 - clean)));
+        }
+    }
+    result.iterations = iterations;
+    if(best.score < 3)
+        return result;
+
+    // local optimization: refit the inliers and take the new inlier set
+    // while it does not get smaller
+    std::vector<uint8_t> mask(n);
+    float lo, hi;
+    band(best.radius, opt.threshold, &lo, &hi);
+    size_t inliers = mark_in_band(xs, ys, (float)best.cx, (float)best.cy, lo, hi, &mask);
+    for(int step = 0; step<opt.refine_steps; step++){
+        double cx, cy, radius;
+        if(!refit(xs, ys, mask, &cx, &cy, &radius))
+            break;
+        std::vector<uint8_t> next(n);
+        band(radius, opt.threshold, &lo, &hi);
+        size_t count = mark_in_band(xs, ys, (float)cx, (float)cy, lo, hi, &next);
+        if(count < inliers)
+            break;
+        best.cx = cx;
+        best.cy = cy;
+        best.radius = radius;
+        mask.swap(next);
+        inliers = count;
+    }
+
+    result.found = true;
+    result.cx = best.cx + ox;
+    result.cy = best.cy + oy;
+    result.radius = best.radius;
+    result.inliers.swap(mask);
+    result.inlier_count = inliers;
+    return result;
+}
+
+// options for fitting cell centers: a circle rounded onto the grid is
+// within three quarters of a cell of its cells
+inline options cell_options(const grid_view& view){
+    options opt;
+    opt.threshold = 0.75*view.patch_size;
+    return opt;
+}
+
+// fit the centers of the selected cells, in canvas pixels; the cells are
+// returned in the order of the inlier mask
+inline circle_result fit_cells(const cell_set& selected, const grid_view& view, std::vector<int> *cell_xs, std::vector<int> *cell_ys,
+                               const options& opt){
+    std::vector<float> xs, ys;
+    xs.reserve(selected.size());
+    ys.reserve(selected.size());
+    cell_xs->clear();
+    cell_ys->clear();
+    selected.for_each([&](int x, int y){
+        cell_xs->push_back(x);
+        cell_ys->push_back(y);
+        xs.push_back((float)view.center_x(x));
+        ys.push_back((float)view.center_y(y));
+    });
+    return fit_circle(xs, ys, opt);
+}
+
+}
+
+// fit_circle() for every method, circle_ransac included; inliers receives
+// the number of points the circle explains (all of them for the other
+// methods) and outliers, when not NULL, the cells it does not
+inline bool fit_selection(circle_method method, const circle_sums& sums, const cell_set& selected, const grid_view& view,
+                          double *cx, double *cy, double *radius, size_t *inliers, cell_set *outliers = NULL){
+    if(outliers != NULL)
+        outliers->clear();
+    if(method != circle_ransac){
+        *inliers = selected.size();
+        return fit_circle(method, sums, selected, view, cx, cy, radius);
+    }
+    std::vector<int> cell_xs, cell_ys;
+    ransac::circle_result fit = ransac::fit_cells(selected, view, &cell_xs, &cell_ys, ransac::cell_options(view));
+    *cx = fit.cx;
+    *cy = fit.cy;
+    *radius = fit.radius;
+    *inliers = fit.inlier_count;
+    if(fit.found && outliers != NULL){
+        for(size_t k = 0; k<fit.inliers.size(); k++){
+            if(!fit.inliers[k])
+                outliers->insert(cell_xs[k], cell_ys[k]);
+        }
+    }
+    return fit.found;
+}
+
+#endif
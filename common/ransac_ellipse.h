@@ -0,0 +1,319 @@
+#ifndef COMMON_RANSAC_ELLIPSE_H
+#define COMMON_RANSAC_ELLIPSE_H
+
+// RANSAC ellipse fit, the ellipse counterpart of ransac::fit_circle.
+// Hypotheses are the conics through 5 random points; conics that are not
+// ellipses (B^2 - 4AC >= 0) are dropped before any point is scored. The
+// others are scored in parallel rounds by counting the points whose
+// Sampson distance |Q|/|grad Q| is below the threshold, 8 or 4 points per
+// instruction. The best ellipse is refined by direct fits of its inliers
+// (see ellipse_fit.h). Rounds, seeding and tie breaking are those of
+// ransac.h, so the result does not depend on the thread count.
+//
+// All of it runs on coordinates moved to the centroid and scaled to unit
+// spread, which keeps both the 5x6 solve and the float scoring well
+// conditioned on large canvases.
+
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+#include "ellipse_fit.h"
+#include "ransac.h"
+
+namespace ransac {
+
+struct ellipse_result {
+    bool found = false;
+    ellipse_params fit = {0, 0, 0, 0, 0};
+    std::vector<uint8_t> inliers;   // 1 for every inlier, in input order
+    size_t inlier_count = 0;
+    int iterations = 0;
+};
+
+// number of points with Q^2 < t2 |grad Q|^2 for the conic q[6]; sets
+// mask[k] to 0/1 for every point when mask is not NULL
+inline size_t count_sampson_scalar(const float *xs, const float *ys, size_t n, const float q[6], float t2, uint8_t *mask){
+    size_t count = 0;
+    for(size_t k = 0; k<n; k++){
+        float x = xs[k], y = ys[k];
+        float v = (q[0]*x + q[1]*y + q[3])*x + (q[2]*y + q[4])*y + q[5];
+        float gx = 2*q[0]*x + q[1]*y + q[3];
+        float gy = q[1]*x + 2*q[2]*y + q[4];
+        uint8_t in = v*v < t2*(gx*gx + gy*gy);
+        if(mask != NULL)
+            mask[k] = in;
+        count += in;
+    }
+    return count;
+}
+
+#ifdef RING_KERNEL_X86
+
+__attribute__((target("avx2")))
+inline size_t count_sampson_avx2(const float *xs, const float *ys, size_t n, const float q[6], float t2){
+    __m256 a = _mm256_set1_ps(q[0]), b = _mm256_set1_ps(q[1]), c = _mm256_set1_ps(q[2]);
+    __m256 d = _mm256_set1_ps(q[3]), e = _mm256_set1_ps(q[4]), f = _mm256_set1_ps(q[5]);
+    __m256 a2 = _mm256_set1_ps(2*q[0]), c2 = _mm256_set1_ps(2*q[2]), vt2 = _mm256_set1_ps(t2);
+    size_t count = 0;
+    size_t k = 0;
+    for(; k+8<=n; k += 8){
+        __m256 x = _mm256_loadu_ps(xs+k);
+        __m256 y = _mm256_loadu_ps(ys+k);
+        __m256 by = _mm256_mul_ps(b, y);
+        __m256 gx = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a2, x), by), d);
+        __m256 gy = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(b, x), _mm256_mul_ps(c2, y)), e);
+        __m256 v = _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a, x), by), d), x),
+                                 _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(c, y), e), y), f));
+        __m256 g2 = _mm256_add_ps(_mm256_mul_ps(gx, gx), _mm256_mul_ps(gy, gy));
+        __m256 in = _mm256_cmp_ps(_mm256_mul_ps(v, v), _mm256_mul_ps(vt2, g2), _CMP_LT_OQ);
+        count += __builtin_popcount(_mm256_movemask_ps(in));
+    }
+    return count + count_sampson_scalar(xs+k, ys+k, n-k, q, t2, NULL);
+}
+
+__attribute__((target("sse2")))
+inline size_t count_sampson_sse2(const float *xs, const float *ys, size_t n, const float q[6], float t2){
+    __m128 a = _mm_set1_ps(q[0]), b = _mm_set1_ps(q[1]), c = _mm_set1_ps(q[2]);
+    __m128 d = _mm_set1_ps(q[3]), e = _mm_set1_ps(q[4]), f = _mm_set1_ps(q[5]);
+    __m128 a2 = _mm_set1_ps(2*q[0]), c2 = _mm_set1_ps(2*q[2]), vt2 = _mm_set1_ps(t2);
+    size_t count = 0;
+    size_t k = 0;
+    for(; k+4<=n; k += 4){
+        __m128 x = _mm_loadu_ps(xs+k);
+        __m128 y = _mm_loadu_ps(ys+k);
+        __m128 by = _mm_mul_ps(b, y);
+        __m128 gx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a2, x), by), d);
+        __m128 gy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(b, x), _mm_mul_ps(c2, y)), e);
+        __m128 v = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a, x), by), d), x),
+                              _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(c, y), e), y), f));
+        __m128 g2 = _mm_add_ps(_mm_mul_ps(gx, gx), _mm_mul_ps(gy, gy));
+        __m128 in = _mm_cmplt_ps(_mm_mul_ps(v, v), _mm_mul_ps(vt2, g2));
+        count += __builtin_popcount(_mm_movemask_ps(in));
+    }
+    return count + count_sampson_scalar(xs+k, ys+k, n-k, q, t2, NULL);
+}
+
+#endif
+
+inline size_t count_sampson(const float *xs, const float *ys, size_t n, const float q[6], float t2){
+#ifdef RING_KERNEL_X86
+    switch(ring_kernel::active_isa()){
+    case ring_kernel::ISA_AVX2:
+        return count_sampson_avx2(xs, ys, n, q, t2);
+    case ring_kernel::ISA_SSE2:
+        return count_sampson_sse2(xs, ys, n, q, t2);
+    default:
+        break;
+    }
+#endif
+    return count_sampson_scalar(xs, ys, n, q, t2, NULL);
+}
+
+// conic through five points, from the null vector of their 5x6 design
+// matrix (Gaussian elimination with full pivoting); false when the points
+// do not determine a single conic
+inline bool conic_through(const double px[5], const double py[5], double conic[6]){
+    double m[5][6];
+    for(int r = 0; r<5; r++){
+        double x = px[r], y = py[r];
+        double row[6] = {x*x, x*y, y*y, x, y, 1};
+        for(int c = 0; c<6; c++)
+            m[r][c] = row[c];
+    }
+    int col[6] = {0, 1, 2, 3, 4, 5};
+    for(int k = 0; k<5; k++){
+        int pr = k, pc = k;
+        for(int r = k; r<5; r++)
+            for(int c = k; c<6; c++)
+                if(fabs(m[r][col[c]]) > fabs(m[pr][col[pc]])){
+                    pr = r;
+                    pc = c;
+                }
+        if(fabs(m[pr][col[pc]]) < 1e-10)
+            return false;
+        for(int c = 0; c<6; c++)
+            std::swap(m[k][c], m[pr][c]);
+        std::swap(col[k], col[pc]);
+        for(int r = k+1; r<5; r++){
+            double f = m[r][col[k]]/m[k][col[k]];
+            for(int c = k; c<6; c++)
+                m[r][col[c]] -= f*m[k][col[c]];
+        }
+    }
+    conic[col[5]] = 1;
+    for(int k = 4; k>=0; k--){
+        double sum = 0;
+        for(int c = k+1; c<6; c++)
+            sum += m[k][col[c]]*conic[col[c]];
+        conic[col[k]] = -sum/m[k][col[k]];
+    }
+    return true;
+}
+
+// set mask[k] for every point within the Sampson threshold of the conic
+// and return their number
+inline size_t mark_sampson(const std::vector<float>& xs, const std::vector<float>& ys, const float q[6], float t2,
+                           std::vector<uint8_t> *mask){
+    int64_t n = (int64_t)xs.size();
+    std::vector<size_t> counts((n + chunk - 1)/chunk);
+    parallel::parallel_for(0, n, chunk, [&](int64_t begin, int64_t end){
+        counts[begin/chunk] = count_sampson_scalar(xs.data()+begin, ys.data()+begin, end-begin, q, t2, mask->data()+begin);
+    });
+    size_t total = 0;
+    for(size_t c = 0; c<counts.size(); c++)
+        total += counts[c];
+    return total;
+}
+
+// fit an ellipse to the points (xs[k], ys[k]); opt.threshold is the
+// Sampson distance of an inlier, in pixels
+inline ellipse_result fit_ellipse(const std::vector<float>& in_xs, const std::vector<float>& in_ys, const options& opt = options()){
+
+    ellipse_result result;
+    size_t n = std::min(in_xs.size(), in_ys.size());
+    if(n < 6)
+        return result;
+
+    // normalize to the centroid and unit spread
+    double ox = 0, oy = 0;
+    for(size_t k = 0; k<n; k++){
+        ox += in_xs[k];
+        oy += in_ys[k];
+    }
+    ox /= n;
+    oy /= n;
+    double spread = 0;
+    for(size_t k = 0; k<n; k++)
+        spread += (in_xs[k]-ox)*(in_xs[k]-ox) + (in_ys[k]-oy)*(in_ys[k]-oy);
+    if(!(spread > 0))
+        return result;
+    double scale = sqrt(spread/(2*n));
+    std::vector<float> xs(n), ys(n);
+    for(size_t k = 0; k<n; k++){
+        xs[k] = (float)((in_xs[k] - ox)/scale);
+        ys[k] = (float)((in_ys[k] - oy)/scale);
+    }
+    double threshold = opt.threshold/scale;
+    float t2 = (float)(threshold*threshold);
+
+    struct hypothesis {
+        float conic[6];
+        int64_t score;
+    };
+    std::vector<hypothesis> round(std::max(opt.round, 1));
+    hypothesis best = {{0, 0, 0, 0, 0, 0}, -1};
+    int64_t required = opt.max_iterations;
+    int iterations = 0;
+
+    while(iterations < required && iterations < opt.max_iterations){
+        int first = iterations;
+        int count = (int)std::min<int64_t>(round.size(), std::min<int64_t>(required, opt.max_iterations) - iterations);
+        parallel::parallel_for(0, count, 1, [&](int64_t begin, int64_t end){
+            for(int64_t h = begin; h<end; h++){
+                hypothesis& hyp = round[h];
+                hyp.score = -1;
+                uint64_t state = opt.seed*0x9e3779b97f4a7c15ull + (uint64_t)(first + h);
+                size_t pick[5];
+                for(int s = 0; s<5; s++){
+                    bool repeated;
+                    do{
+                        pick[s] = (size_t)(((splitmix64(&state) >> 32)*(uint64_t)n) >> 32);
+                        repeated = false;
+                        for(int t = 0; t<s; t++)
+                            repeated |= pick[t] == pick[s];
+                    } while(repeated);
+                }
+                double px[5], py[5], conic[6];
+                for(int s = 0; s<5; s++){
+                    px[s] = xs[pick[s]];
+                    py[s] = ys[pick[s]];
+                }
+
+                // only ellipses are scored
+                if(!conic_through(px, py, conic) || conic[1]*conic[1] - 4*conic[0]*conic[2] >= 0)
+                    continue;
+                double norm = 0;
+                for(int c = 0; c<6; c++)
+                    norm = std::max(norm, fabs(conic[c]));
+                for(int c = 0; c<6; c++)
+                    hyp.conic[c] = (float)(conic[c]/norm);
+                hyp.score = (int64_t)count_sampson(xs.data(), ys.data(), n, hyp.conic, t2);
+            }
+        });
+        iterations += count;
+
+        // best so far, earliest hypothesis on ties
+        for(int h = 0; h<count; h++){
+            if(round[h].score > best.score)
+                best = round[h];
+        }
+
+        // rounds needed for a clean 5-point sample given the inlier ratio
+        if(best.score > 0){
+            double w = (double)best.score/n;
+            double clean = w*w*w*w*w;
+            if(clean >= 1)
+                required = iterations;
+            else if(clean > 0)
+                required = std::min<int64_t>(opt.max_iterations,
+                    (int64_t)ceil(log(1 - opt.confidence)/log(1 - clean)));
+        }
+    }
+    result.iterations = iterations;
+    if(best.score < 6)
+        return result;
+
+    // the best conic as an ellipse, in normalized units
+    double conic[6];
+    for(int c = 0; c<6; c++)
+        conic[c] = best.conic[c];
+    ellipse_params fit;
+    if(!conic_to_ellipse(conic, 0, 0, 1, &fit))
+        return result;
+
+    // local optimization: direct fit of the inliers, taking the new
+    // inlier set while it does not get smaller
+    std::vector<uint8_t> mask(n);
+    size_t inliers = mark_sampson(xs, ys, best.conic, t2, &mask);
+    std::vector<float> in_x, in_y;
+    for(int step = 0; step<opt.refine_steps; step++){
+        in_x.clear();
+        in_y.clear();
+        for(size_t k = 0; k<n; k++){
+            if(mask[k]){
+                in_x.push_back(xs[k]);
+                in_y.push_back(ys[k]);
+            }
+        }
+        ellipse_params next_fit;
+        if(!fit_ellipse_points(in_x.data(), in_y.data(), in_x.size(), &next_fit))
+            break;
+        double next_conic[6];
+        float q[6];
+        ellipse_to_conic(next_fit, 0, 0, 1, next_conic);
+        for(int c = 0; c<6; c++)
+            q[c] = (float)next_conic[c];
+        std::vector<uint8_t> next(n);
+        size_t count = mark_sampson(xs, ys, q, t2, &next);
+        if(count < inliers)
+            break;
+        fit = next_fit;
+        mask.swap(next);
+        inliers = count;
+    }
+
+    result.found = true;
+    result.fit.center_x = ox + scale*fit.center_x;
+    result.fit.center_y = oy + scale*fit.center_y;
+    result.fit.width = scale*fit.width;
+    result.fit.height = scale*fit.height;
+    result.fit.angle = fit.angle;
+    result.inliers.swap(mask);
+    result.inlier_count = inliers;
+    return result;
+}
+
+}
+
+#endif
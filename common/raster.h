@@ -0,0 +1,212 @@
+#ifndef COMMON_RASTER_H
+#define COMMON_RASTER_H
+
+// Curve rasterizers that only visit pixels near the curve, so their cost
+// follows the circumference instead of the canvas area. Pixels are handed
+// to a plot(x, y) callback and are already clipped to [0, cols) x [0, rows).
+
+#include <math.h>
+#include <algorithm>
+
+namespace raster {
+
+// plot the 8 symmetric images of octant offset (x, y) around (cx, cy)
+template<class Plot>
+inline void plot_octants(int cx, int cy, int x, int y, int cols, int rows, Plot& plot){
+    const int px[8] = {cx+x, cx-x, cx+x, cx-x, cx+y, cx-y, cx+y, cx-y};
+    const int py[8] = {cy+y, cy+y, cy-y, cy-y, cy+x, cy+x, cy-x, cy-x};
+    for(int k = 0; k<8; k++){
+        if(px[k]>=0 && px[k]<cols && py[k]>=0 && py[k]<rows)
+            plot(px[k], py[k]);
+    }
+}
+
+// every pixel whose distance d to the integer center satisfies
+// |d - radius| < half_width, i.e. the band the full-frame loops used to
+// threshold. The octant x >= y >= 0 is walked row by row with the inner
+// and outer edges updated incrementally (midpoint style, no sqrt per
+// pixel) and mirrored 8 ways.
+template<class Plot>
+inline void ring_band(int cx, int cy, double radius, double half_width, int cols, int rows, Plot plot){
+
+    if(radius + half_width <= 0)
+        return;
+
+    // squared distance bounds, both exclusive; as in band_limits the
+    // center is only in the band when half_width > radius
+    double inner = radius - half_width;
+    double lo = inner >= 0 ? inner*inner : -1.;
+    double hi = (radius + half_width)*(radius + half_width);
+
+    // outer edge: largest x with x^2+y^2 < hi
+    long long x_out = (long long)sqrt(hi);
+    double e_out = (double)x_out*x_out;
+    while(e_out >= hi){
+        e_out -= 2*x_out - 1;
+        x_out--;
+    }
+    while(e_out + 2*x_out + 1 < hi){
+        e_out += 2*x_out + 1;
+        x_out++;
+    }
+
+    // inner edge: smallest x >= 0 with x^2+y^2 > lo
+    long long x_in = lo < 0 ? 0 : (long long)sqrt(lo);
+    double e_in = (double)x_in*x_in;
+    while(e_in <= lo){
+        e_in += 2*x_in + 1;
+        x_in++;
+    }
+    while(x_in > 0 && e_in - 2*x_in + 1 > lo){
+        e_in -= 2*x_in - 1;
+        x_in--;
+    }
+
+    for(long long y = 0; y <= x_out; y++){
+        if(y > 0){
+            // moving one row out raises both edge errors by 2y-1
+            e_out += 2*y - 1;
+            e_in += 2*y - 1;
+            while(e_out >= hi){
+                e_out -= 2*x_out - 1;
+                x_out--;
+            }
+            while(x_in > 0 && e_in - 2*x_in + 1 > lo){
+                e_in -= 2*x_in - 1;
+                x_in--;
+            }
+            if(y > x_out)
+                break;
+        }
+        for(long long x = x_in > y ? x_in : y; x <= x_out; x++)
+            plot_octants(cx, cy, (int)x, (int)y, cols, rows, plot);
+    }
+}
+
+// one-pixel circle around an integer center with the midpoint algorithm,
+// integer arithmetic only
+template<class Plot>
+inline void midpoint_circle(int cx, int cy, int radius, int cols, int rows, Plot plot){
+    if(radius < 0)
+        return;
+    int x = radius;
+    int y = 0;
+    int err = 1 - radius;
+    while(x >= y){
+        plot_octants(cx, cy, x, y, cols, rows, plot);
+        y++;
+        if(err < 0)
+            err += 2*y + 1;
+        else{
+            x--;
+            err += 2*(y - x) + 1;
+        }
+    }
+}
+
+// rotated ellipse with a sub-pixel center and axes: width is the full
+// length of the axis at angle degrees, height the other one, as in
+// cv::RotatedRect. plot(x, y, coverage) gets coverage in (0, 1] for the
+// pixels whose distance d to the curve is below thickness/2; with
+// antialias the band gets a one pixel falloff instead of a hard edge.
+//
+// Only rows of the bounding box are visited, and in each row only the
+// spans between the ellipse scaled out and in by the band's reach. Along
+// a span the quadratic form Q (1 on the curve) and its gradient are
+// updated by forward differences. d is the first-order distance of
+// sqrt(Q) - 1, which is exact for circles. The cost follows the
+// circumference times the thickness.
+//
+// The span ends come from solving the row's quadratic, not from a midpoint
+// walk carried over between rows: coverage needs a true distance, which a
+// midpoint decision variable does not give, and ends off screen cost
+// nothing to solve while a walk would have to step through them.
+template<class Plot>
+inline void smooth_ellipse(double cx, double cy, double width, double height, double angle, double thickness,
+                           int cols, int rows, bool antialias, Plot plot){
+
+    double a = width/2, b = height/2;
+    if(!(a > 0) || !(b > 0) || !(thickness > 0))
+        return;
+    double half = thickness/2;
+    double edge = antialias ? half + 0.5 : std::max(half, 0.5);
+
+    // Q(X, Y) = A X^2 + B XY + C Y^2 around the center
+    double t = angle*M_PI/180;
+    double c = cos(t), s = sin(t);
+    double A = c*c/(a*a) + s*s/(b*b);
+    double B = 2*c*s*(1/(a*a) - 1/(b*b));
+    double C = s*s/(a*a) + c*c/(b*b);
+
+    // every pixel within reach of the curve lies between the ellipse
+    // scaled by 1 - reach/b_min and 1 + reach/b_min
+    double reach = edge + 1;
+    double outer = 1 + reach/std::min(a, b);
+    double inner = 1 - reach/std::min(a, b);
+    double ey = outer*sqrt(a*a*s*s + b*b*c*c);
+
+    // plot the pixels of [x0, x1] in row y, walking Q along the row
+    auto span = [&](long long x0, long long x1, long long y){
+        x0 = std::max(x0, 0LL);
+        x1 = std::min(x1, (long long)cols - 1);
+        if(x1 < x0)
+            return;
+        double X = x0 - cx, Y = y - cy;
+        double q = A*X*X + B*X*Y + C*Y*Y;
+        double dq = A*(2*X + 1) + B*Y;
+        double gx = 2*A*X + B*Y;
+        double gy = B*X + 2*C*Y;
+        for(long long x = x0; x <= x1; x++){
+            double root = sqrt(q);
+            double d = 2*root*fabs(root - 1)/sqrt(gx*gx + gy*gy);
+            if(d < edge)
+                plot((int)x, (int)y, antialias ? (float)std::min(1., edge - d) : 1.f);
+            q += dq;
+            dq += 2*A;
+            gx += 2*A;
+            gy += B;
+        }
+    };
+
+    long long y0 = std::max((long long)ceil(cy - ey), 0LL);
+    long long y1 = std::min((long long)floor(cy + ey), (long long)rows - 1);
+    for(long long y = y0; y <= y1; y++){
+        // A X^2 + B Y X + C Y^2 = k^2 for the outer and inner scale k
+        double Y = y - cy;
+        double disc_out = B*B*Y*Y - 4*A*(C*Y*Y - outer*outer);
+        if(disc_out < 0)
+            continue;
+        double r_out = sqrt(disc_out);
+        long long l_out = (long long)ceil(cx + (-B*Y - r_out)/(2*A));
+        long long h_out = (long long)floor(cx + (-B*Y + r_out)/(2*A));
+        double disc_in = inner > 0 ? B*B*Y*Y - 4*A*(C*Y*Y - inner*inner) : -1;
+        if(disc_in <= 0){
+            span(l_out, h_out, y);
+            continue;
+        }
+        double r_in = sqrt(disc_in);
+        long long l_in = (long long)floor(cx + (-B*Y - r_in)/(2*A));
+        long long h_in = (long long)ceil(cx + (-B*Y + r_in)/(2*A));
+        span(l_out, l_in, y);
+        span(std::max(h_in, l_in + 1), h_out, y);
+    }
+}
+
+// circle with a sub-pixel center and radius, one pixel wide; the special
+// case of smooth_ellipse. Without antialias it is the midpoint circle
+// around the rounded center and radius, with coverage 1 (pixels on the
+// octant borders may be plotted twice).
+template<class Plot>
+inline void smooth_circle(double cx, double cy, double radius, int cols, int rows, bool antialias, Plot plot){
+    if(!antialias){
+        midpoint_circle((int)lround(cx), (int)lround(cy), (int)lround(radius), cols, rows, [&](int x, int y){
+            plot(x, y, 1.f);
+        });
+        return;
+    }
+    smooth_ellipse(cx, cy, 2*radius, 2*radius, 0., 1., cols, rows, antialias, plot);
+}
+
+}
+
+#endif
@@ -0,0 +1,260 @@
+#ifndef COMMON_THREAD_POOL_H
+#define COMMON_THREAD_POOL_H
+
+// Small shared thread pool with parallel-for helpers. Work is split into a
+// fixed set of tasks (index ranges or frame tiles) that depend only on the
+// input size, never on the thread count, so every pass produces the same
+// result however many threads run it.
+//
+// The thread count defaults to the number of cores. It can be set with
+// parallel::set_thread_count() or the PARALLEL_THREADS environment variable;
+// 1 runs everything on the calling thread.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace parallel {
+
+class thread_pool
+{
+public:
+    explicit thread_pool(int threads) : stopping(false), generation(0) {
+        for(int t = 1; t<threads; t++)
+            workers.push_back(std::thread([this](){ worker_loop(); }));
+    }
+
+    ~thread_pool(){
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for(size_t t = 0; t<workers.size(); t++)
+            workers[t].join();
+    }
+
+    int size() const { return (int)workers.size() + 1; }
+
+    // run fn(0) .. fn(tasks-1) across the pool and the calling thread and
+    // return once all of them finished. Calls from inside a task run inline.
+    void run(int tasks, const std::function<void(int)>& fn){
+        if(tasks <= 0)
+            return;
+        if(workers.empty() || tasks == 1 || inside_task()){
+            for(int k = 0; k<tasks; k++)
+                fn(k);
+            return;
+        }
+
+        std::lock_guard<std::mutex> serial(run_lock);
+        std::shared_ptr<batch> current = std::make_shared<batch>(&fn, tasks);
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            active = current;
+            generation++;
+        }
+        wake.notify_all();
+        work(*current);
+
+        std::unique_lock<std::mutex> guard(lock);
+        done.wait(guard, [&](){ return current->pending == 0; });
+        active.reset();
+    }
+
+private:
+    // one call to run(); workers that wake late only ever see the batch
+    // they were woken for, whose tasks are then already claimed
+    struct batch {
+        batch(const std::function<void(int)> *fn, int count) : fn(fn), count(count), next(0), pending(count) {}
+        const std::function<void(int)> *fn;
+        int count;
+        std::atomic<int> next;
+        int pending;
+    };
+
+    static bool& inside_task(){
+        static thread_local bool flag = false;
+        return flag;
+    }
+
+    // claim and run tasks until none are left
+    void work(batch& b){
+        inside_task() = true;
+        int finished = 0;
+        for(int k = b.next.fetch_add(1); k < b.count; k = b.next.fetch_add(1)){
+            (*b.fn)(k);
+            finished++;
+        }
+        inside_task() = false;
+        if(finished){
+            std::lock_guard<std::mutex> guard(lock);
+            b.pending -= finished;
+            if(b.pending == 0)
+                done.notify_all();
+        }
+    }
+
+    void worker_loop(){
+        uint64_t seen = 0;
+        while(true){
+            std::shared_ptr<batch> current;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                wake.wait(guard, [&](){ return stopping || generation != seen; });
+                if(stopping)
+                    return;
+                seen = generation;
+                current = active;
+            }
+            if(current)
+                work(*current);
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex lock;
+    std::mutex run_lock;
+    std::condition_variable wake;
+    std::condition_variable done;
+    bool stopping;
+    uint64_t generation;
+    std::shared_ptr<batch> active;
+};
+
+inline int default_thread_count(){
+    const char *env = getenv("PARALLEL_THREADS");
+    if(env != NULL && atoi(env) > 0)
+        return atoi(env);
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+struct pool_state {
+    std::mutex lock;
+    int threads = default_thread_count();
+    std::shared_ptr<thread_pool> pool;
+};
+
+inline pool_state& state(){
+    static pool_state s;
+    return s;
+}
+
+inline int thread_count(){
+    std::lock_guard<std::mutex> guard(state().lock);
+    return state().threads;
+}
+
+// change the number of threads; the pool is rebuilt on next use
+inline void set_thread_count(int threads){
+    std::lock_guard<std::mutex> guard(state().lock);
+    state().threads = threads > 0 ? threads : default_thread_count();
+    state().pool.reset();
+}
+
+inline std::shared_ptr<thread_pool> shared_pool(){
+    std::lock_guard<std::mutex> guard(state().lock);
+    if(!state().pool)
+        state().pool = std::make_shared<thread_pool>(state().threads);
+    return state().pool;
+}
+
+// call f(begin, end) on consecutive chunks of at most grain indices
+template<class F>
+inline void parallel_for(int64_t begin, int64_t end, int64_t grain, F f){
+    if(end <= begin)
+        return;
+    grain = std::max<int64_t>(grain, 1);
+    int64_t chunks = (end - begin + grain - 1)/grain;
+    shared_pool()->run((int)chunks, [&](int k){
+        int64_t b = begin + k*grain;
+        f(b, std::min(end, b + grain));
+    });
+}
+
+// call f(begin, end) on chunks of at most grain indices, for loops whose
+// iterations vary a lot in cost. Every task starts with an equal share of
+// the range and takes grain indices at a time from its front; a task that
+// runs dry steals the back half of another task's remaining range.
+template<class F>
+inline void parallel_for_stealing(int64_t begin, int64_t end, int64_t grain, F f){
+    if(end <= begin)
+        return;
+    grain = std::max<int64_t>(grain, 1);
+    int64_t total = end - begin;
+    std::shared_ptr<thread_pool> pool = shared_pool();
+    int tasks = (int)std::min<int64_t>(pool->size(), (total + grain - 1)/grain);
+    if(tasks <= 1 || total >= ((int64_t)1 << 32)){
+        parallel_for(begin, end, grain, f);
+        return;
+    }
+
+    // each range is [lo, hi) relative to begin, packed as lo | hi << 32
+    auto pack = [](uint64_t lo, uint64_t hi){ return lo | hi << 32; };
+    std::vector<std::atomic<uint64_t>> ranges(tasks);
+    for(int k = 0; k<tasks; k++)
+        ranges[k].store(pack(total*k/tasks, total*(k+1)/tasks));
+
+    pool->run(tasks, [&](int k){
+        while(true){
+            // take from the front of the own range
+            uint64_t r = ranges[k].load();
+            uint64_t lo = r & 0xffffffff, hi = r >> 32;
+            if(lo < hi){
+                uint64_t take = std::min<uint64_t>(grain, hi - lo);
+                if(ranges[k].compare_exchange_weak(r, pack(lo + take, hi)))
+                    f(begin + (int64_t)lo, begin + (int64_t)(lo + take));
+                continue;
+            }
+
+            // steal the back half of the first non-empty range
+            bool stole = false;
+            for(int step = 1; step<tasks && !stole; step++){
+                int victim = (k + step) % tasks;
+                uint64_t v = ranges[victim].load();
+                while(true){
+                    uint64_t vlo = v & 0xffffffff, vhi = v >> 32;
+                    if(vlo >= vhi)
+                        break;
+                    uint64_t mid = vlo + (vhi - vlo)/2;
+                    if(ranges[victim].compare_exchange_weak(v, pack(vlo, mid))){
+                        ranges[k].store(pack(mid, vhi));
+                        stole = true;
+                        break;
+                    }
+                }
+            }
+            if(!stole)
+                return;
+        }
+    });
+}
+
+// tile edge in pixels; a 64x64 tile of a CV_8UC3 frame is 12 KB, so a
+// tile and its working set stay in L1/L2
+const int tile_size = 64;
+
+// call f(x0, y0, x1, y1) for every tile of the rectangle [x0, x1) x [y0, y1)
+template<class F>
+inline void for_each_tile(int x0, int y0, int x1, int y1, F f){
+    if(x1 <= x0 || y1 <= y0)
+        return;
+    int tiles_x = (x1 - x0 + tile_size - 1)/tile_size;
+    int tiles_y = (y1 - y0 + tile_size - 1)/tile_size;
+    shared_pool()->run(tiles_x*tiles_y, [&](int k){
+        int tx = x0 + (k % tiles_x)*tile_size;
+        int ty = y0 + (k / tiles_x)*tile_size;
+        f(tx, ty, std::min(tx + tile_size, x1), std::min(ty + tile_size, y1));
+    });
+}
+
+}
+
+#endif
@@ -0,0 +1,171 @@
+// Command line front end for q1/circle_engine.h.
+//
+// Reads one query per line, "center_x center_y end_x end_y" in grid cells
+// (commas are accepted as separators, lines starting with '#' are skipped),
+// and writes one CSV row per query:
+//
+//     index,count,min_radius,max_radius,radius[,cells]
+//
+// usage: batch [--threads N] [--point-size P] [--cols C] [--rows R] [--cells] [input [output]]
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "circle_engine.h"
+
+static bool read_all(const char *path, std::string *text){
+    if(path == NULL || strcmp(path, "-") == 0){
+        std::stringstream ss;
+        ss << std::cin.rdbuf();
+        *text = ss.str();
+        return true;
+    }
+    std::ifstream in(path, std::ios::binary);
+    if(!in)
+        return false;
+    std::stringstream ss;
+    ss << in.rdbuf();
+    *text = ss.str();
+    return true;
+}
+
+static bool parse_queries(const std::string& text, std::vector<q1::circle_query> *queries){
+    const char *p = text.c_str();
+    int line = 1;
+    while(*p){
+        // skip blank lines and comments
+        while(*p == ' ' || *p == '\t' || *p == '\r')
+            p++;
+        if(*p == '\n'){
+            p++;
+            line++;
+            continue;
+        }
+        if(*p == '#'){
+            while(*p && *p != '\n')
+                p++;
+            continue;
+        }
+        if(*p == 0)
+            break;
+
+        long v[4];
+        for(int k = 0; k<4; k++){
+            while(*p == ' ' || *p == '\t' || *p == ',')
+                p++;
+            char *next;
+            errno = 0;
+            v[k] = strtol(p, &next, 10);
+            if(next == p){
+                std::cerr << "Error: malformed query on line " << line << std::endl;
+                return false;
+            }
+            if(errno == ERANGE || v[k] < INT_MIN || v[k] > INT_MAX){
+                std::cerr << "Error: value out of range on line " << line << std::endl;
+                return false;
+            }
+            p = next;
+        }
+        while(*p && *p != '\n')
+            p++;
+        q1::circle_query q;
+        q.center.x = (int)v[0];
+        q.center.y = (int)v[1];
+        q.end.x = (int)v[2];
+        q.end.y = (int)v[3];
+        queries->push_back(q);
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    // same layout as the q1 window by default
+    q1::grid_params grid;
+    grid.point_size = 9;
+    grid.patch_size = 3*grid.point_size;
+    grid.cols = 20;
+    grid.rows = 20;
+    int threads = 0;
+    bool write_cells = false;
+    const char *input = NULL;
+    const char *output = NULL;
+
+    for(int k = 1; k<argc; k++){
+        std::string arg = argv[k];
+        if(arg == "--threads" && k+1<argc)
+            threads = atoi(argv[++k]);
+        else if(arg == "--point-size" && k+1<argc){
+            grid.point_size = atoi(argv[++k]);
+            grid.patch_size = 3*grid.point_size;
+        }
+        else if(arg == "--cols" && k+1<argc)
+            grid.cols = atoi(argv[++k]);
+        else if(arg == "--rows" && k+1<argc)
+            grid.rows = atoi(argv[++k]);
+        else if(arg == "--cells")
+            write_cells = true;
+        else if(input == NULL)
+            input = argv[k];
+        else if(output == NULL)
+            output = argv[k];
+        else{
+            std::cerr << "usage: batch [--threads N] [--point-size P] [--cols C] [--rows R] [--cells] [input [output]]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::string text;
+    if(!read_all(input, &text)){
+        std::cerr << "Error: cannot open " << input << std::endl;
+        return 1;
+    }
+    std::vector<q1::circle_query> queries;
+    if(!parse_queries(text, &queries))
+        return 1;
+    for(size_t k = 0; k<queries.size(); k++){
+        const q1::cell& c = queries[k].center;
+        const q1::cell& e = queries[k].end;
+        if(c.x<0 || c.x>=grid.cols || c.y<0 || c.y>=grid.rows){
+            std::cerr << "Error: center of query " << k << " is outside the grid" << std::endl;
+            return 1;
+        }
+        if(e.x<0 || e.x>=grid.cols || e.y<0 || e.y>=grid.rows){
+            std::cerr << "Error: end of query " << k << " is outside the grid" << std::endl;
+            return 1;
+        }
+    }
+
+    if(threads > 0)
+        parallel::set_thread_count(threads);
+    std::vector<q1::circle_result> results = q1::solve_batch(queries, grid);
+
+    FILE *out = stdout;
+    if(output != NULL && strcmp(output, "-") != 0){
+        out = fopen(output, "w");
+        if(out == NULL){
+            std::cerr << "Error: cannot write " << output << std::endl;
+            return 1;
+        }
+    }
+    fprintf(out, write_cells ? "index,count,min_radius,max_radius,radius,cells\n" : "index,count,min_radius,max_radius,radius\n");
+    for(size_t k = 0; k<results.size(); k++){
+        const q1::circle_result& r = results[k];
+        fprintf(out, "%zu,%zu,%g,%g,%g", k, r.cells.size(), r.min_radius, r.max_radius, r.radius);
+        if(write_cells){
+            fputc(',', out);
+            for(size_t c = 0; c<r.cells.size(); c++)
+                fprintf(out, c == 0 ? "%d:%d" : " %d:%d", r.cells[c].x, r.cells[c].y);
+        }
+        fputc('\n', out);
+    }
+    if(out != stdout)
+        fclose(out);
+    return 0;
+}
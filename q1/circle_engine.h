@@ -0,0 +1,219 @@
+#ifndef Q1_CIRCLE_ENGINE_H
+#define Q1_CIRCLE_ENGINE_H
+
+// Headless version of the q1 circle logic: given a center cell and a
+// circumference cell it finds the grid cells on the circle and the
+// min/max/target boundary radii, without any OpenCV window or framebuffer.
+
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+#include "../common/thread_pool.h"
+
+namespace q1 {
+
+struct cell {
+    int x;
+    int y;
+};
+
+// layout of the dotted grid, in the same units as q1/main.cpp
+struct grid_params {
+    int point_size;
+    int patch_size;
+    int cols;
+    int rows;
+};
+
+struct circle_query {
+    cell center;
+    cell end;
+};
+
+struct circle_result {
+    std::vector<cell> cells;
+    float min_radius;
+    float max_radius;
+    float radius;
+};
+
+// exact integer form of |sqrt(i^2+j^2) - sqrt(r2)| < 0.5
+inline bool on_circle(int64_t s, int64_t r2){
+    int64_t outer = 4*(s-r2) - 1;
+    int64_t inner = 4*(r2-s) - 1;
+    if(outer >= 0 && outer*outer >= 16*r2)
+        return false;
+    if(inner >= 0 && inner*inner >= 16*s)
+        return false;
+    return true;
+}
+
+// offsets on the circle of squared radius r2, in row-major order. Only the
+// octant 0 <= dy <= dx is searched, a few candidates per row around the
+// analytic edges, and the hits are mirrored 8 ways.
+inline std::vector<cell> circle_offsets(int64_t r2){
+
+    double r = sqrt((double)r2);
+    double inner = r > 0.5 ? (r-0.5)*(r-0.5) : 0.;
+    double outer = (r+0.5)*(r+0.5);
+
+    std::vector<cell> octant;
+    for(int64_t dy = 0; 2*dy*dy < outer; dy++){
+        int64_t lo = (int64_t)sqrt(std::max(0., inner - (double)(dy*dy))) - 1;
+        int64_t hi = (int64_t)sqrt(outer - (double)(dy*dy)) + 1;
+        for(int64_t dx = std::max(lo, dy); dx <= hi; dx++){
+            if(on_circle(dx*dx + dy*dy, r2))
+                octant.push_back(cell{(int)dx, (int)dy});
+        }
+    }
+
+    std::vector<cell> offsets;
+    offsets.reserve(octant.size()*8);
+    for(size_t k = 0; k<octant.size(); k++){
+        int x = octant[k].x;
+        int y = octant[k].y;
+        const cell mirrored[8] = {{x, y}, {-x, y}, {x, -y}, {-x, -y}, {y, x}, {-y, x}, {y, -x}, {-y, -x}};
+        offsets.insert(offsets.end(), mirrored, mirrored+8);
+    }
+    std::sort(offsets.begin(), offsets.end(), [](const cell& a, const cell& b){
+        return a.y != b.y ? a.y < b.y : a.x < b.x;
+    });
+    offsets.erase(std::unique(offsets.begin(), offsets.end(), [](const cell& a, const cell& b){
+        return a.x == b.x && a.y == b.y;
+    }), offsets.end());
+    return offsets;
+}
+
+// cache of circle_offsets keyed by the squared radius, which is all the
+// integer grid offset between center and circumference point determines.
+// Entries are shared so a reader keeps its table alive across an eviction.
+class cell_table
+{
+public:
+    explicit cell_table(size_t max_entries = 4096) : max_entries(max_entries) {}
+
+    std::shared_ptr<const std::vector<cell> > offsets(int64_t r2){
+        {
+            std::shared_lock<std::shared_mutex> read(lock);
+            auto it = table.find(r2);
+            if(it != table.end())
+                return it->second;
+        }
+        std::shared_ptr<const std::vector<cell> > entry = std::make_shared<const std::vector<cell> >(circle_offsets(r2));
+        std::unique_lock<std::shared_mutex> write(lock);
+        if(table.size() >= max_entries)
+            table.clear();
+        return table.emplace(r2, entry).first->second;
+    }
+
+private:
+    size_t max_entries;
+    std::shared_mutex lock;
+    std::unordered_map<int64_t, std::shared_ptr<const std::vector<cell> > > table;
+};
+
+inline cell_table& shared_cell_table(){
+    static cell_table table;
+    return table;
+}
+
+// find the grid cells whose offset from the center lies on the circle
+// through the end cell, in row-major order. The end cell may be off the
+// grid; a center off the grid, or a circle that passes beyond every grid
+// cell, selects nothing and never reaches the offset table.
+inline std::vector<cell> select_cells(cell center, cell end, const grid_params& grid){
+
+    std::vector<cell> cells;
+    if(center.x<0 || center.x>=grid.cols || center.y<0 || center.y>=grid.rows)
+        return cells;
+    int64_t dx = (int64_t)end.x-center.x;
+    int64_t dy = (int64_t)end.y-center.y;
+    int64_t far_x = std::max(center.x, grid.cols-1-center.x);
+    int64_t far_y = std::max(center.y, grid.rows-1-center.y);
+    if(hypot((double)dx, (double)dy) >= hypot((double)far_x, (double)far_y) + 1)
+        return cells;
+    std::shared_ptr<const std::vector<cell> > offsets = shared_cell_table().offsets(dx*dx + dy*dy);
+
+    for(size_t k = 0; k<offsets->size(); k++){
+        int ii = (*offsets)[k].x + center.x;
+        int jj = (*offsets)[k].y + center.y;
+        if(ii>=0 && ii<grid.cols && jj>=0 && jj<grid.rows)
+            cells.push_back(cell{ii, jj});
+    }
+    return cells;
+}
+
+// squared distance range from the pixel center to the pixels of one
+// point_size x point_size cell block along a single axis
+inline void axis_range(int64_t lo, int64_t hi, int64_t *near_sq, int64_t *far_sq){
+    int64_t far = std::max(lo < 0 ? -lo : lo, hi < 0 ? -hi : hi);
+    int64_t near = 0;
+    if(lo > 0)
+        near = lo;
+    else if(hi < 0)
+        near = -hi;
+    *near_sq = near*near;
+    *far_sq = far*far;
+}
+
+// min/max distance from the center pixel to any pixel of the selected
+// cells, and the target radius halfway between them
+inline void boundary_radii(const std::vector<cell>& cells, cell center, const grid_params& grid,
+                           float *min_radius, float *max_radius, float *radius){
+
+    // rescale the center back to the original size
+    int64_t cx = (int64_t)center.x*grid.patch_size + (grid.point_size+1)/2;
+    int64_t cy = (int64_t)center.y*grid.patch_size + (grid.point_size+1)/2;
+
+    if(cells.empty()){
+        *min_radius = 0;
+        *max_radius = 0;
+        *radius = 0;
+        return;
+    }
+
+    int64_t min_sq = INT64_MAX;
+    int64_t max_sq = 0;
+    for(size_t k = 0; k<cells.size(); k++){
+        int64_t x0 = (int64_t)cells[k].x*grid.patch_size - cx;
+        int64_t y0 = (int64_t)cells[k].y*grid.patch_size - cy;
+        int64_t near_x, far_x, near_y, far_y;
+        axis_range(x0, x0+grid.point_size-1, &near_x, &far_x);
+        axis_range(y0, y0+grid.point_size-1, &near_y, &far_y);
+        min_sq = std::min(min_sq, near_x+near_y);
+        max_sq = std::max(max_sq, far_x+far_y);
+    }
+    *min_radius = (float)sqrt((double)min_sq);
+    *max_radius = (float)sqrt((double)max_sq);
+    *radius = (*max_radius+*min_radius)/2.f;
+}
+
+inline circle_result solve(const circle_query& query, const grid_params& grid){
+    circle_result result;
+    result.cells = select_cells(query.center, query.end, grid);
+    boundary_radii(result.cells, query.center, grid, &result.min_radius, &result.max_radius, &result.radius);
+    return result;
+}
+
+// solve every query on the shared thread pool; results keep the order of
+// the queries
+inline std::vector<circle_result> solve_batch(const std::vector<circle_query>& queries, const grid_params& grid){
+
+    // fixed chunks of queries on the shared pool; each result only depends
+    // on its own query, so the output is the same for any thread count
+    std::vector<circle_result> results(queries.size());
+    parallel::parallel_for(0, (int64_t)queries.size(), 256, [&](int64_t begin, int64_t end){
+        for(int64_t k = begin; k<end; k++)
+            results[k] = solve(queries[k], grid);
+    });
+    return results;
+}
+
+}
+
+#endif
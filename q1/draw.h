@@ -0,0 +1,68 @@
+#ifndef Q1_DRAW_H
+#define Q1_DRAW_H
+
+#include <math.h>
+#include <opencv2/opencv.hpp>
+#include "circle_engine.h"
+#include "../common/grid_view.h"
+#include "../common/overlay.h"
+#include "../common/raster.h"
+
+namespace q1 {
+
+inline grid_params engine_params(const grid_view& view){
+    grid_params grid = {view.point_size, view.patch_size, view.cols, view.rows};
+    return grid;
+}
+
+inline void draw(cv::Mat *frame, const grid_view& view, cv::Point xy, cv::Vec3b color, overlay *layer = NULL){
+
+    // only cells inside the viewport are rendered
+    if(!view.visible(xy.x, xy.y))
+        return;
+
+    if(layer != NULL)
+        layer->add_cell(view, xy.x, xy.y);
+
+    // rescale the selected point back to the original size
+    xy.x = view.pixel_x(xy.x);
+    xy.y = view.pixel_y(xy.y);
+
+    // draw the points in specified color
+    for(int jj = 0; jj<view.point_size; jj++){
+        for(int ii = 0; ii<view.point_size; ii++){
+            (*frame).at<cv::Vec3b>(xy.y+jj, xy.x+ii) = color;
+        }
+    }
+}
+
+inline void draw_boundary(cv::Mat *frame, const grid_view& view, const std::vector<q1::cell>& cells, cv::Point center, overlay *layer = NULL){
+
+    cv::Vec3b red(0, 0, 255);
+    cv::Vec3b blue(255, 0, 0);
+
+    // find max, min, and target radius from the selected cells
+    float max_radius, min_radius, radius;
+    q1::boundary_radii(cells, q1::cell{center.x, center.y}, engine_params(view), &min_radius, &max_radius, &radius);
+
+    // rescale the center back to the original size, relative to the viewport
+    int cx = (int)(view.center_x(center.x) - view.offset_x());
+    int cy = (int)(view.center_y(center.y) - view.offset_y());
+
+    // draw the target circle in blue and the boundary circles in red on top,
+    // visiting only the pixels within a pixel of each circle
+    auto paint_blue = [frame, blue](int x, int y){ (*frame).at<cv::Vec3b>(y, x) = blue; };
+    auto paint_red = [frame, red](int x, int y){ (*frame).at<cv::Vec3b>(y, x) = red; };
+    raster::ring_band(cx, cy, radius, 1., (*frame).cols, (*frame).rows, paint_blue);
+    raster::ring_band(cx, cy, max_radius, 1., (*frame).cols, (*frame).rows, paint_red);
+    raster::ring_band(cx, cy, min_radius, 1., (*frame).cols, (*frame).rows, paint_red);
+    if(layer != NULL){
+        layer->add_ring(cx, cy, radius, 1.);
+        layer->add_ring(cx, cy, max_radius, 1.);
+        layer->add_ring(cx, cy, min_radius, 1.);
+    }
+}
+
+}
+
+#endif
@@ -6,88 +6,37 @@
 #include <math.h> 
 #include <opencv2/opencv.hpp>
 #include "cvui.h"
+#include "draw.h"
+#include "../common/grid_background.h"
 
 #define WINDOW_NAME "CVUI"
 
 
-void draw(cv::Mat src, cv::Mat *frame, cv::Point xy, cv::Vec3b color, const int point_size, int patch_size){
-    
-    // rescale the selected point back to the original size
-    xy.x = xy.x*patch_size;
-    xy.y = xy.y*patch_size;
-    
-    // draw the points in specified color
-    for(int jj = 0; jj<point_size; jj++){
-        for(int ii = 0; ii<point_size; ii++){
-            (*frame).at<cv::Vec3b>(xy.y+jj, xy.x+ii) = color;
-        }
-    }
-}
-
-void draw_boundary(cv::Mat *frame, cv::Point center, cv::Vec3b color, int patch_size, int point_size){
-    
-    float distance;
-    cv::Vec3b red(0, 0, 255);
-    cv::Vec3b blue(255, 0, 0);
-    
-    // rescale the center back to the original size
-    center.x = center.x*patch_size + (point_size+1)/2;
-    center.y = center.y*patch_size + (point_size+1)/2;
-    
-    // find max, min, and target radius
-    float max_radius = 0;
-    float min_radius = 100000000;
-    float radius;
-    for(int jj = 0; jj<(*frame).rows; jj++){
-        for(int ii = 0; ii<(*frame).cols; ii++){
-            if((*frame).at<cv::Vec3b>(jj, ii) == color){
-                distance = sqrt(pow((float)jj-(float)center.y, 2)+pow((float)ii-(float)center.x, 2));
-                if(distance>max_radius)
-                    max_radius = distance;
-                else if(distance<min_radius)
-                    min_radius = distance;
-            }
-        }
-    }
-    radius = (max_radius+min_radius)/2.;
-    
-    // draw the boundary points and the target circle points in blue
-    for(int jj = 0; jj<(*frame).rows; jj++){
-        for(int ii = 0; ii<(*frame).cols; ii++){
-            distance = sqrt(pow((float)jj-(float)center.y, 2)+pow((float)ii-(float)center.x, 2));
-            // set the threshold to a pixel size
-            if(abs(distance-max_radius)<1. || abs(distance-min_radius)<1.)
-                (*frame).at<cv::Vec3b>(jj, ii) = red;
-            else if(abs(distance-radius)<1.){
-                (*frame).at<cv::Vec3b>(jj, ii) = blue;
-            }
-        }
-    }
-}
-
-int main()
+int main(int argc, char **argv)
 {
-    // initialize sizes
+    // initialize sizes, the grid size can be given on the command line
     const int point_size = 9;
-    const int patch_size = 3*point_size;
-    const int image_size = 60*point_size;
+    int cols, rows;
+    if(!grid_size_args(argc, argv, &cols, &rows)){
+        std::cerr << "usage: main [cols [rows]]" << std::endl;
+        return 1;
+    }
+    grid_view view = make_grid_view(cols, rows, point_size);
+    q1::grid_params grid = q1::engine_params(view);
     
     // initialize colors
     cv::Vec3b gray(150, 150, 150);
     cv::Vec3b blue(255, 0, 0);
     cv::Vec3b red(0, 0, 255);
     
-    // initialize images
-    cv::Mat src(image_size, image_size, CV_8UC3, cv::Scalar(255, 255, 255));
-    cv::Mat src_ref = cv::Mat::zeros(20, 20, CV_8U); // may be deleted in this application
-    for(int j=0; j<src.rows; j++){
-        for(int i=0; i<src.cols; i++){
-            if(i%patch_size<point_size && j%patch_size<point_size){
-                src.at<cv::Vec3b>(j, i) = gray;
-            }
-        }
-    }
+    // initialize images, only the visible part of the grid is rendered
+    cv::Mat src(view.height, view.width, CV_8UC3, cv::Scalar(255, 255, 255));
+    draw_grid_background(&src, view, gray);
     cv::Mat frame = src.clone();
+    
+    // everything drawn over the grid is tracked so it can be undone
+    // without copying the whole frame
+    overlay layer;
 
     // Init a OpenCV window and tell cvui to use it.
     cv::namedWindow(WINDOW_NAME);
@@ -97,10 +46,16 @@ int main()
     cv::Point cursor_down;
     cv::Point cursor_up;
     bool clicked = false;
-    float radius, radius_tmp;
-    float max_radius = 0.;
-    float min_radius = 10000000.;
-    int jj, ii;
+    std::vector<q1::cell> cells;
+    
+    // the cells are cached and only recomputed when the center or
+    // circumference point changes; the frame is only repainted when the
+    // result or the viewport changes
+    bool cached = false;
+    bool repaint = true;
+    cv::Point cached_down;
+    cv::Point cached_up;
+    long skipped = 0;
 
     // enter GUI
     while (true)
@@ -108,8 +63,8 @@ int main()
         // set center of the circle
         if (cvui::mouse(cvui::LEFT_BUTTON, cvui::DOWN) && !clicked) {
             cursor_down = cvui::mouse();
-            cursor_down.x = cursor_down.x/patch_size;
-            cursor_down.y = cursor_down.y/patch_size;
+            cursor_down.x = view.cell_x(cursor_down.x);
+            cursor_down.y = view.cell_y(cursor_down.y);
             std::cout << "begin point" << std::endl;
             std::cout << "x: " << cursor_down.x << " y: " << cursor_down.y << std::endl;
         }
@@ -117,56 +72,72 @@ int main()
         // set the target circumference point
         if (cvui::mouse(cvui::LEFT_BUTTON, cvui::UP) && !clicked) {
             cursor_up = cvui::mouse();
-            cursor_up.x = cursor_up.x/patch_size;
-            cursor_up.y = cursor_up.y/patch_size;
+            cursor_up.x = view.cell_x(cursor_up.x);
+            cursor_up.y = view.cell_y(cursor_up.y);
             std::cout << "end point" << std::endl;
             std::cout << "x: " << cursor_up.x << " y: " << cursor_up.y << std::endl;
-            clicked = true;
+            clicked = view.contains(cursor_down.x, cursor_down.y);
         }
         
         // reset the system by right clicking the mouse
         if (cvui::mouse(cvui::RIGHT_BUTTON, cvui::DOWN) && clicked){
-            src.copyTo(frame);
             clicked = false;
+            cached = false;
+            repaint = true;
+            std::cout << "recomputations skipped: " << skipped << std::endl;
+        }
+        
+        // reuse the cached cells while the inputs are unchanged
+        if(clicked && cached && cursor_down == cached_down && cursor_up == cached_up){
+            skipped++;
         }
         
         // clicked indicates the system is ready to draw
-        if(clicked){
+        else if(clicked){
             
-            // mark center(red)
-            draw(src, &frame, cursor_down, red, point_size, patch_size);
+            // find circumference
+            cells = q1::select_cells(q1::cell{cursor_down.x, cursor_down.y}, q1::cell{cursor_up.x, cursor_up.y}, grid);
             
-            // find circumference and mark the pixels as blue
-            radius = sqrt(pow((float)cursor_up.x-(float)cursor_down.x, 2) + pow((float)cursor_up.y-(float)cursor_down.y, 2));
-            for(int j=-ceil(radius); j<ceil(radius)+1; j++){
-                for(int i=-ceil(radius); i<ceil(radius)+1; i++){
-                    jj = j+cursor_down.y;
-                    ii = i+cursor_down.x;
-                    if(jj>=0 && jj<src_ref.rows && ii>=0 && ii<src_ref.cols){
-                        radius_tmp = sqrt(pow((float)j, 2) + pow((float)i, 2));
-                        // the threshold is set to be half of a pixel size
-                        if(abs(radius_tmp-radius) < 0.5){
-                            draw(src, &frame, cv::Point(ii, jj), blue, point_size, patch_size);
-                        }
-                        
-                    }
+            cached = true;
+            cached_down = cursor_down;
+            cached_up = cursor_up;
+            repaint = true;
+        }
+        
+        // paint the visible part of the result
+        if(repaint){
+            layer.clear(&frame, src);
+            if(clicked){
+                
+                // mark center(red)
+                q1::draw(&frame, view, cursor_down, red, &layer);
+                
+                // mark the circumference pixels as blue
+                for(size_t k = 0; k<cells.size(); k++){
+                    q1::draw(&frame, view, cv::Point(cells[k].x, cells[k].y), blue, &layer);
                 }
+                
+                // draw boundary
+                q1::draw_boundary(&frame, view, cells, cursor_down, &layer);
             }
-            
-            // draw boundary
-            draw_boundary(&frame, cursor_down, blue, patch_size, point_size);
         }
-        
 
         // Update cvui internal stuff
         cvui::update();
-        imshow(WINDOW_NAME, frame);
+        if(repaint){
+            imshow(WINDOW_NAME, frame);
+            repaint = false;
+        }
 
-        // press ESC to exit the system
-        if (cv::waitKey(30) == 27)
+        // press ESC to exit the system, w/a/s/d to scroll
+        int key = cv::waitKey(30);
+        if (key == 27)
         {
             break;
         }
+        if (scroll_key(&view, key))
+            repaint = true;
     }
+    std::cout << "recomputations skipped: " << skipped << std::endl;
     return 0;
 }
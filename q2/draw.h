@@ -0,0 +1,89 @@
+#ifndef Q2_DRAW_H
+#define Q2_DRAW_H
+
+#include <math.h>
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#include "../common/circle_fit.h"
+#include "../common/grid_view.h"
+#include "../common/overlay.h"
+#include "../common/ransac.h"
+#include "../common/raster.h"
+
+namespace q2 {
+
+inline void draw(cv::Mat *frame, const grid_view& view, cv::Point xy, cv::Vec3b color, overlay *layer = NULL){
+    
+    // only cells inside the viewport are rendered
+    if(!view.visible(xy.x, xy.y))
+        return;
+    
+    if(layer != NULL)
+        layer->add_cell(view, xy.x, xy.y);
+    
+    // rescale the selected point back to the original size
+    xy.x = view.pixel_x(xy.x);
+    xy.y = view.pixel_y(xy.y);
+    
+    // draw the points in specified color
+    for(int jj = 0; jj<view.point_size; jj++){
+        for(int ii = 0; ii<view.point_size; ii++){
+            (*frame).at<cv::Vec3b>(xy.y+jj, xy.x+ii) = color;
+        }
+    }
+}
+
+// draw a fitted circle given in canvas pixels into the viewport; the
+// center and radius keep their sub-pixel position and the curve is
+// anti-aliased, or a midpoint circle when antialias is false
+inline void paint_circle(cv::Mat *frame, const grid_view& view, cv::Point2d center, double radius, cv::Vec3b color,
+                         overlay *layer = NULL, bool antialias = true){
+    
+    double cx = center.x - view.offset_x();
+    double cy = center.y - view.offset_y();
+    int mx = (int)lround(cx);
+    int my = (int)lround(cy);
+    
+    // mark the center as red (added to better visualize the result)
+    if(mx>=0 && mx<(*frame).cols && my>=0 && my<(*frame).rows)
+        (*frame).at<cv::Vec3b>(my, mx) = color;
+    
+    // draw the calculated circle, blending each pixel by its coverage
+    raster::smooth_circle(cx, cy, radius, (*frame).cols, (*frame).rows, antialias, [frame, color](int x, int y, float coverage){
+        cv::Vec3b& pixel = (*frame).at<cv::Vec3b>(y, x);
+        for(int c = 0; c<3; c++)
+            pixel[c] = (uchar)lround(pixel[c] + (color[c] - pixel[c])*coverage);
+    });
+    
+    // the curve stays within a pixel of the radius, so within 2 pixels of
+    // it measured from the rounded center
+    if(layer != NULL){
+        layer->add_rect(cv::Rect(mx, my, 1, 1));
+        layer->add_ring(mx, my, radius, 2.);
+    }
+}
+
+// fit a circle to the selection with the given method and draw it; the
+// fitted center and radius are returned in canvas pixels, and with RANSAC
+// the cells left out of the fit in outliers when it is not NULL
+inline bool draw_circle(circle_method method, const circle_sums& sums, const cell_set& selected, const grid_view& view,
+                        cv::Mat *frame, cv::Vec3b color, cv::Point2d *center, double *radius, overlay *layer = NULL,
+                        cell_set *outliers = NULL){
+    
+    // find the circle
+    double cx, cy, r;
+    size_t inliers;
+    if(!fit_selection(method, sums, selected, view, &cx, &cy, &r, &inliers, outliers))
+        return false;
+    if(method == circle_ransac)
+        std::cout << "inliers: " << inliers << " of " << selected.size() << std::endl;
+    *center = cv::Point2d(cx, cy);
+    *radius = r;
+    
+    paint_circle(frame, view, *center, *radius, color, layer);
+    return true;
+}
+
+}
+
+#endif
@@ -7,84 +7,40 @@
 #include <math.h> 
 #include <opencv2/opencv.hpp>
 #include "cvui.h"
+#include "draw.h"
+#include "../common/grid_background.h"
 
 #define WINDOW_NAME "CVUI"
 
 
-void draw(cv::Mat *frame, cv::Point xy, cv::Vec3b color, const int point_size, int patch_size){
-    
-    // rescale the selected point back to the original size
-    xy.x = xy.x*patch_size;
-    xy.y = xy.y*patch_size;
-    
-    // draw the points in specified color
-    for(int jj = 0; jj<point_size; jj++){
-        for(int ii = 0; ii<point_size; ii++){
-            (*frame).at<cv::Vec3b>(xy.y+jj, xy.x+ii) = color;
-        }
-    }
-}
-
-void draw_circle(cv::Mat src_ref, cv::Mat *frame, cv::Point center, cv::Vec3b color, int patch_size, int point_size){
-    
-    // initialize the parameters
-    float radius = 0;
-    float count = 0;
-    float distance;
-    
-    // find mean radius
-    for(int jj = 0; jj<src_ref.rows; jj++){
-        for(int ii = 0; ii<src_ref.cols; ii++){
-            if(src_ref.at<float>(jj, ii) == 1.){
-                // rescale back to original size
-                jj = jj*patch_size + (point_size+1)/2;
-                ii = ii*patch_size + (point_size+1)/2;
-                radius += sqrt(pow((float)jj-(float)center.y, 2)+pow((float)ii-(float)center.x, 2));
-                count++;
-            }
-        }
-    }
-    
-    // find the radius
-    radius /= count;
-    
-    // mark the center as red (added to better visualize the result)
-    (*frame).at<cv::Vec3b>(center.y, center.x) = color;
-    
-    // draw the calculated circle
-    for(int jj = 0; jj<(*frame).rows; jj++){
-        for(int ii = 0; ii<(*frame).cols; ii++){
-            distance = sqrt(pow((float)jj-(float)center.y, 2)+pow((float)ii-(float)center.x, 2));
-            // set the threshold to a pixel size
-            if(abs(distance-radius)<1.)
-                (*frame).at<cv::Vec3b>(jj, ii) = color;
-        }
-    }
-}
-
-int main()
+int main(int argc, char **argv)
 {
-    // initialize sizes
+    // initialize sizes, the grid size can be given on the command line
     const int point_size = 9;
-    const int patch_size = 3*point_size;
-    const int image_size = 60*point_size;
+    int cols, rows;
+    if(!grid_size_args(argc, argv, &cols, &rows)){
+        std::cerr << "usage: main [cols [rows]]" << std::endl;
+        return 1;
+    }
+    grid_view view = make_grid_view(cols, rows, point_size);
+    const int image_size = view.height;
     
     // initialize colors
     cv::Vec3b gray(150, 150, 150);
     cv::Vec3b blue(255, 0, 0);
     cv::Vec3b red(0, 0, 255);
     
-    // initialize images
-    cv::Mat src(image_size+100, image_size, CV_8UC3, cv::Scalar(255, 255, 255));
-    cv::Mat src_ref = cv::Mat::zeros(20, 20, CV_32F);
-    for(int j=0; j<image_size; j++){
-        for(int i=0; i<image_size; i++){
-            if(i%patch_size<point_size && j%patch_size<point_size){
-                src.at<cv::Vec3b>(j, i) = gray;
-            }
-        }
-    }
+    // initialize images, only the visible part of the grid is rendered and
+    // the selection is kept apart from it
+    cv::Mat src(view.height+100, view.width, CV_8UC3, cv::Scalar(255, 255, 255));
+    cell_set selected;
+    cell_set outliers;
+    draw_grid_background(&src, view, gray);
     cv::Mat frame = src.clone();
+    
+    // everything drawn over the grid is tracked so it can be undone
+    // without copying the whole frame
+    overlay layer;
 
     // Init a OpenCV window and tell cvui to use it.
     cv::namedWindow(WINDOW_NAME);
@@ -92,71 +48,93 @@ int main()
     
     // initialize templates and paremeters
     cv::Point cursor;
-    cv::Point center(0, 0);
-    float radius, radius_tmp;
-    int count = 0;
+    cv::Point2d center(0, 0);
+    circle_sums sums;
+    double radius = 0;
+    circle_method method = circle_taubin;
     bool clicked = false;
+    bool repaint = false;
     
     while (true)
     {
         // generate the circle when click the 'generate' button
-        if (cvui::button(frame, image_size/2-80, image_size+30, 100, 40, "Generate")){
+        if (cvui::button(frame, view.width/2-80, image_size+30, 100, 40, "Generate")){
             // to regularize the generate behavior
-            if(!clicked && count!=0){
-                center.x /= count;
-                center.y /= count;
-                draw_circle(src_ref, &frame, center, blue, patch_size, point_size);
-                clicked = true;
+            if(!clicked && sums.count()!=0){
+                clicked = q2::draw_circle(method, sums, selected, view, &frame, blue, &center, &radius, &layer, &outliers);
+                if(!clicked)
+                    std::cerr<<"Warning: No circle fits the selected points"<<std::endl;
+                
+                // cells the RANSAC fit left out are shown in red
+                for_each_visible(outliers, view, [&](int x, int y){
+                    q2::draw(&frame, view, cv::Point(x, y), red, &layer);
+                });
             }
             else{
                 std::cerr<<"Warning: Please select points before generate"<<std::endl;
             }
         }
         
+        // switch between the mean, Kasa, Pratt, Taubin and RANSAC fits
+        if (cvui::button(frame, view.width/2+40, image_size+30, 100, 40, circle_method_name(method))){
+            method = next_circle_method(method);
+            std::cout << "fit method: " << circle_method_name(method) << std::endl;
+        }
+        
         // deal with selecting points
         if (cvui::mouse(cvui::LEFT_BUTTON, cvui::UP)){
             cursor = cvui::mouse();
-            cursor.x = cursor.x/patch_size;
-            cursor.y = cursor.y/patch_size;
+            cursor.x = view.cell_x(cursor.x);
+            cursor.y = view.cell_y(cursor.y);
             
             // mark the point if it hasn't been selected
-            if(frame.at<cv::Vec3b>(cursor.y*patch_size+1, cursor.x*patch_size+1)==gray){
-                center.x += cursor.x*patch_size + (point_size+1)/2;
-                center.y += cursor.y*patch_size + (point_size+1)/2;
-                count += 1;
-                src_ref.at<float>(cursor.y, cursor.x) = 1.;
-                draw(&frame, cursor, blue, point_size, patch_size);
+            if(view.visible(cursor.x, cursor.y) && !selected.contains(cursor.x, cursor.y)){
+                sums.add_cell(view, cursor.x, cursor.y);
+                selected.insert(cursor.x, cursor.y);
+                q2::draw(&frame, view, cursor, blue, &layer);
             }
             
             // unmark the point if it has already been selected
-            else if(frame.at<cv::Vec3b>(cursor.y*patch_size+1, cursor.x*patch_size+1)==blue){
-                center.x -= cursor.x*patch_size + (point_size+1)/2;
-                center.y -= cursor.y*patch_size + (point_size+1)/2;
-                count -= 1;
-                src_ref.at<float>(cursor.y, cursor.x) = 0.;
-                draw(&frame, cursor, gray, point_size, patch_size);
+            else if(view.visible(cursor.x, cursor.y)){
+                sums.remove_cell(view, cursor.x, cursor.y);
+                selected.erase(cursor.x, cursor.y);
+                outliers.erase(cursor.x, cursor.y);
+                q2::draw(&frame, view, cursor, gray, &layer);
             }
         }
         
         // reset the system by right clicking the mouse
         if (cvui::mouse(cvui::RIGHT_BUTTON, cvui::UP)){
-            src.copyTo(frame);
-            src_ref = cv::Mat::zeros(20, 20, CV_32F);
-            center.x = 0;
-            center.y = 0;
-            count = 0;
+            layer.clear(&frame, src);
+            selected.clear();
+            outliers.clear();
+            sums.clear();
             clicked = false;
         }
         
+        // repaint the viewport after scrolling
+        if(repaint){
+            layer.clear(&frame, src);
+            for_each_visible(selected, view, [&](int x, int y){
+                q2::draw(&frame, view, cv::Point(x, y), outliers.contains(x, y) ? red : blue, &layer);
+            });
+            if(clicked)
+                q2::paint_circle(&frame, view, center, radius, blue, &layer);
+            repaint = false;
+        }
+        
         // Update cvui internal stuff
         cvui::update();
         imshow(WINDOW_NAME, frame);
         
-        // press ESC to exit the system
-        if (cv::waitKey(30) == 27)
+        // press ESC to exit the system, w/a/s/d to scroll
+        int key = cv::waitKey(30);
+        if (key == 27)
         {
             break;
         }
+        if (scroll_key(&view, key))
+            repaint = true;
     }
     return 0;
 }
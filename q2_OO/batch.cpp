@@ -0,0 +1,256 @@
+// Command line front end for q2_OO/batch_fit.h and common/pointset_io.h.
+//
+//     batch convert [--float] input.csv output.pset
+//
+// converts CSV rows "set,x,y" into a point-set file; a new set starts
+// whenever the set column changes (lines starting with '#' are skipped).
+// Coordinates are stored as int32 when all of them are integral, as float
+// otherwise or with --float.
+//
+//     batch fit [--threads N] [--method M] [--outliers] input.pset [output]
+//
+// maps a point-set file and fits a circle to every set with M one of mean,
+// kasa, pratt, taubin (default) or ransac, writing one CSV row per set:
+//
+//     index,points,found,center_x,center_y,radius,inliers[,outliers]
+//
+// with --outliers the last column lists the points RANSAC left out of the
+// fit, as space separated indices within the set.
+//
+//     batch stream [--threads N] [--method M] [--outliers] [input]
+//
+// runs as a filter: reads points and "fit" delimiters (see
+// common/point_stream.h) from stdin, a file or a FIFO and writes the row of
+// every set as soon as the set is complete.
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "batch_fit.h"
+#include "../common/point_stream.h"
+
+static bool parse_method(const std::string& name, circle_method *method){
+    for(int k = 0; k<5; k++){
+        std::string known = circle_method_name((circle_method)k);
+        for(size_t c = 0; c<known.size(); c++)
+            known[c] = (char)tolower(known[c]);
+        if(name == known){
+            *method = (circle_method)k;
+            return true;
+        }
+    }
+    return false;
+}
+
+static int convert(const char *input, const char *output, bool force_float){
+    FILE *in = strcmp(input, "-") == 0 ? stdin : fopen(input, "r");
+    if(in == NULL){
+        std::cerr << "Error: cannot open " << input << std::endl;
+        return 1;
+    }
+
+    // coordinates are kept as double until the stored type is known
+    std::vector<uint64_t> offsets(1, 0);
+    std::vector<double> xs, ys;
+    bool integral = !force_float;
+    bool first = true;
+    long long current = 0;
+    char line[256];
+    int number = 0;
+    while(fgets(line, sizeof(line), in) != NULL){
+        number++;
+        const char *p = line;
+        while(*p == ' ' || *p == '\t')
+            p++;
+        if(*p == '#' || *p == '\n' || *p == '\r' || *p == 0)
+            continue;
+
+        char *next;
+        long long set = strtoll(p, &next, 10);
+        bool ok = next != p;
+        p = next;
+        double v[2];
+        for(int k = 0; k<2 && ok; k++){
+            while(*p == ' ' || *p == '\t' || *p == ',')
+                p++;
+            v[k] = strtod(p, &next);
+            ok = next != p;
+            p = next;
+        }
+        if(!ok){
+            // a header row is allowed on the first line
+            if(number == 1)
+                continue;
+            std::cerr << "Error: malformed row on line " << number << std::endl;
+            if(in != stdin)
+                fclose(in);
+            return 1;
+        }
+
+        if(!first && set != current)
+            offsets.push_back(xs.size());
+        first = false;
+        current = set;
+        xs.push_back(v[0]);
+        ys.push_back(v[1]);
+        integral = integral && v[0] == floor(v[0]) && v[1] == floor(v[1]) &&
+                   fabs(v[0]) <= INT32_MAX && fabs(v[1]) <= INT32_MAX;
+    }
+    if(in != stdin)
+        fclose(in);
+    if(!xs.empty())
+        offsets.push_back(xs.size());
+
+    bool ok;
+    if(integral){
+        std::vector<int32_t> ix(xs.begin(), xs.end()), iy(ys.begin(), ys.end());
+        ok = pointset_io::write_sets(output, offsets, ix, iy);
+    }
+    else{
+        std::vector<float> fx(xs.begin(), xs.end()), fy(ys.begin(), ys.end());
+        ok = pointset_io::write_sets(output, offsets, fx, fy);
+    }
+    if(!ok){
+        std::cerr << "Error: cannot write " << output << std::endl;
+        return 1;
+    }
+    std::cerr << offsets.size()-1 << " sets, " << xs.size() << " points, "
+              << (integral ? "int32" : "float") << " coordinates" << std::endl;
+    return 0;
+}
+
+// the columns after index and points, shared by fit and stream
+static void write_fit(FILE *out, const set_fit& f, bool write_outliers){
+    fprintf(out, ",%d,%g,%g,%g,%zu", f.found ? 1 : 0, f.center_x, f.center_y, f.radius, f.inliers);
+    if(write_outliers){
+        fputc(',', out);
+        for(size_t i = 0; i<f.outliers.size(); i++)
+            fprintf(out, i == 0 ? "%u" : " %u", f.outliers[i]);
+    }
+    fputc('\n', out);
+}
+
+static const char *fit_header(bool write_outliers){
+    return write_outliers ? "index,points,found,center_x,center_y,radius,inliers,outliers\n"
+                          : "index,points,found,center_x,center_y,radius,inliers\n";
+}
+
+static int fit(const char *input, const char *output, circle_method method, bool write_outliers){
+    pointset_io::mapped_sets sets;
+    if(!sets.open(input)){
+        std::cerr << "Error: " << input << ": " << sets.error() << std::endl;
+        return 1;
+    }
+    std::vector<set_fit> fits = fit_mapped_sets(sets, method);
+
+    FILE *out = stdout;
+    if(output != NULL && strcmp(output, "-") != 0){
+        out = fopen(output, "w");
+        if(out == NULL){
+            std::cerr << "Error: cannot write " << output << std::endl;
+            return 1;
+        }
+    }
+    const uint64_t *offsets = sets.offsets();
+    fputs(fit_header(write_outliers), out);
+    for(size_t k = 0; k<fits.size(); k++){
+        fprintf(out, "%zu,%llu", k, (unsigned long long)(offsets[k+1] - offsets[k]));
+        write_fit(out, fits[k], write_outliers);
+    }
+    if(out != stdout)
+        fclose(out);
+    return 0;
+}
+
+static int stream(const char *input, circle_method method, bool write_outliers){
+    int fd = 0;
+    if(input != NULL && strcmp(input, "-") != 0){
+        fd = open(input, O_RDONLY);
+        if(fd < 0){
+            std::cerr << "Error: cannot open " << input << std::endl;
+            return 1;
+        }
+    }
+
+    // the reader parses the next batch while this one is fitted
+    point_stream::batch sets;
+    point_stream::reader reader(fd);
+    fputs(fit_header(write_outliers), stdout);
+    while(reader.next(&sets)){
+        std::vector<set_fit> fits = fit_sets(sets.size(), sets.offsets.data(), sets.xs.data(), sets.ys.data(),
+                                             method, ransac::options());
+        for(size_t k = 0; k<fits.size(); k++){
+            printf("%llu,%llu", (unsigned long long)(sets.first + k),
+                   (unsigned long long)(sets.offsets[k+1] - sets.offsets[k]));
+            write_fit(stdout, fits[k], write_outliers);
+        }
+        fflush(stdout);
+    }
+    if(fd != 0)
+        close(fd);
+    if(!reader.error().empty()){
+        std::cerr << "Error: " << reader.error() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *usage = "usage: batch convert [--float] input.csv output.pset\n"
+                        "       batch fit [--threads N] [--method mean|kasa|pratt|taubin|ransac] [--outliers] input.pset [output]\n"
+                        "       batch stream [--threads N] [--method mean|kasa|pratt|taubin|ransac] [--outliers] [input]";
+    if(argc < 2){
+        std::cerr << usage << std::endl;
+        return 1;
+    }
+    std::string mode = argv[1];
+    int threads = 0;
+    bool force_float = false;
+    bool write_outliers = false;
+    circle_method method = circle_taubin;
+    const char *input = NULL;
+    const char *output = NULL;
+
+    for(int k = 2; k<argc; k++){
+        std::string arg = argv[k];
+        if(arg == "--threads" && k+1<argc)
+            threads = atoi(argv[++k]);
+        else if(arg == "--float")
+            force_float = true;
+        else if(arg == "--outliers")
+            write_outliers = true;
+        else if(arg == "--method" && k+1<argc){
+            if(!parse_method(argv[++k], &method)){
+                std::cerr << "Error: unknown method " << argv[k] << std::endl;
+                return 1;
+            }
+        }
+        else if(input == NULL)
+            input = argv[k];
+        else if(output == NULL)
+            output = argv[k];
+        else{
+            std::cerr << usage << std::endl;
+            return 1;
+        }
+    }
+
+    if(mode == "convert" && input != NULL && output != NULL)
+        return convert(input, output, force_float);
+    if(threads > 0)
+        parallel::set_thread_count(threads);
+    if(mode == "fit" && input != NULL)
+        return fit(input, output, method, write_outliers);
+    if(mode == "stream" && output == NULL)
+        return stream(input, method, write_outliers);
+    std::cerr << usage << std::endl;
+    return 1;
+}
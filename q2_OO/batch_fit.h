@@ -0,0 +1,107 @@
+#ifndef Q2_OO_BATCH_FIT_H
+#define Q2_OO_BATCH_FIT_H
+
+// Fit many independent point sets in one call, without a window or a
+// circleModel per set. The sets live in one structure-of-arrays buffer:
+// set k holds the points xs[i], ys[i] for offsets[k] <= i < offsets[k+1].
+// Point-set files (common/pointset_io.h) are fitted in place from their
+// mapping. Sets are spread over the shared thread pool with work stealing, since
+// their sizes can differ by orders of magnitude; every fit only reads its
+// own set, so the results do not depend on the thread count.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "../common/circle_fit.h"
+#include "../common/pointset_io.h"
+#include "../common/ransac.h"
+#include "../common/thread_pool.h"
+
+struct point_sets {
+    std::vector<int64_t> offsets = std::vector<int64_t>(1, 0);
+    std::vector<double> xs;
+    std::vector<double> ys;
+
+    size_t size() const { return offsets.size() - 1; }
+    size_t points(size_t k) const { return (size_t)(offsets[k+1] - offsets[k]); }
+
+    // append a point to the last set, or close it and start a new one
+    void push(double x, double y){
+        xs.push_back(x);
+        ys.push_back(y);
+    }
+    void end_set(){ offsets.push_back((int64_t)xs.size()); }
+
+    void clear(){
+        offsets.assign(1, 0);
+        xs.clear();
+        ys.clear();
+    }
+};
+
+struct set_fit {
+    bool found;
+    double center_x;
+    double center_y;
+    double radius;
+    size_t inliers;
+    std::vector<uint32_t> outliers;   // indices within the set, RANSAC only
+};
+
+// fit count sets given as an offsets table and two coordinate arrays of
+// any numeric type; sets the method cannot fit (too few or collinear
+// points) come back with found = false
+template<class Offset, class T>
+inline std::vector<set_fit> fit_sets(size_t count, const Offset *offsets, const T *set_xs, const T *set_ys,
+                                     circle_method method, const ransac::options& opt){
+
+    std::vector<set_fit> fits(count);
+    parallel::parallel_for_stealing(0, (int64_t)count, 64, [&](int64_t begin, int64_t end){
+        std::vector<float> xs, ys;
+        for(int64_t k = begin; k<end; k++){
+            set_fit& fit = fits[k];
+            const T *x = set_xs + offsets[k];
+            const T *y = set_ys + offsets[k];
+            size_t n = (size_t)(offsets[k+1] - offsets[k]);
+            fit.inliers = 0;
+            fit.outliers.clear();
+            if(method != circle_ransac){
+                fit.found = fit_point_array(method, x, y, n, &fit.center_x, &fit.center_y, &fit.radius);
+                if(fit.found)
+                    fit.inliers = n;
+                continue;
+            }
+            xs.assign(x, x + n);
+            ys.assign(y, y + n);
+            ransac::circle_result r = ransac::fit_circle(xs, ys, opt);
+            fit.found = r.found;
+            fit.center_x = r.cx;
+            fit.center_y = r.cy;
+            fit.radius = r.radius;
+            fit.inliers = r.inlier_count;
+            if(r.found){
+                for(size_t i = 0; i<r.inliers.size(); i++){
+                    if(!r.inliers[i])
+                        fit.outliers.push_back((uint32_t)i);
+                }
+            }
+        }
+    });
+    return fits;
+}
+
+// fit every set with the given method
+inline std::vector<set_fit> fit_point_sets(const point_sets& sets, circle_method method = circle_taubin,
+                                           const ransac::options& opt = ransac::options()){
+    return fit_sets(sets.size(), sets.offsets.data(), sets.xs.data(), sets.ys.data(), method, opt);
+}
+
+// fit every set of a mapped point-set file, straight from the mapping
+inline std::vector<set_fit> fit_mapped_sets(const pointset_io::mapped_sets& sets, circle_method method = circle_taubin,
+                                            const ransac::options& opt = ransac::options()){
+    if(sets.type() == pointset_io::COORD_INT32)
+        return fit_sets(sets.set_count(), sets.offsets(), sets.xs<int32_t>(), sets.ys<int32_t>(), method, opt);
+    return fit_sets(sets.set_count(), sets.offsets(), sets.xs<float>(), sets.ys<float>(), method, opt);
+}
+
+#endif
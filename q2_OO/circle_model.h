@@ -0,0 +1,189 @@
+#ifndef Q2_OO_CIRCLE_MODEL_H
+#define Q2_OO_CIRCLE_MODEL_H
+
+// Headless core of q2_OO: the selected cells of a grid and the incremental
+// circle fit over them. It has no OpenCV or framebuffer dependency, so it
+// can be linked into tools and services on its own; circleUI renders it.
+//
+// Every edit is kept in an undo log of small deltas (a cell flipped, a fit
+// replaced), so undo and redo cost O(1) each and keep the running sums
+// exact; a fit delta carries the fits before and after it, so it is never
+// recomputed.
+
+#include <stddef.h>
+#include <vector>
+#include "../common/circle_fit.h"
+#include "../common/grid_view.h"
+#include "../common/ransac.h"
+
+// a fitted circle, or fitted = false
+struct circle_state {
+    bool fitted;
+    double center_x;
+    double center_y;
+    double radius;
+    size_t inliers;
+};
+
+// one entry of the undo log; for fits, index points into the fit log
+struct model_edit {
+    enum kind_t { cell_selected, cell_deselected, circle_refit };
+    kind_t kind;
+    int x;
+    int y;
+    size_t index;
+};
+
+class circleModel
+{
+public:
+    // grid layout; only its geometry is used, never the viewport
+    grid_view layout;
+    circle_method method = circle_taubin;
+    
+    // last fitted circle in canvas pixels, valid while fitted is set
+    bool fitted = false;
+    double center_x = 0;
+    double center_y = 0;
+    double radius = 0;
+    size_t inliers = 0;
+    
+    explicit circleModel(const grid_view& layout) : layout(layout) {}
+    
+    // select a cell; false when it is off the grid or already selected
+    bool select(int x, int y){
+        if(!layout.contains(x, y) || selected.contains(x, y))
+            return false;
+        apply_select(x, y);
+        record(model_edit{model_edit::cell_selected, x, y, 0});
+        return true;
+    }
+    
+    // deselect a cell; false when it was not selected
+    bool deselect(int x, int y){
+        if(!selected.contains(x, y))
+            return false;
+        apply_deselect(x, y);
+        record(model_edit{model_edit::cell_deselected, x, y, 0});
+        return true;
+    }
+    
+    // flip a cell of the grid and return whether it is now selected
+    bool toggle(int x, int y){
+        if(deselect(x, y))
+            return false;
+        return select(x, y);
+    }
+    
+    // fit a circle to the selection with the current method; false when
+    // nothing is selected or no circle fits
+    bool fit(){
+        circle_state before = state();
+        fitted = selected.size() != 0 &&
+                 fit_selection(method, sums, selected, layout, &center_x, &center_y, &radius, &inliers);
+        record(model_edit{model_edit::circle_refit, 0, 0, 0});
+        fits.push_back(fit_change{before, state()});
+        return fitted;
+    }
+    
+    // clear the selection, the fit and the undo log
+    void reset(){
+        selected.clear();
+        sums.clear();
+        fitted = false;
+        history.clear();
+        fits.clear();
+        done = 0;
+    }
+    
+    bool can_undo() const { return done > 0; }
+    bool can_redo() const { return done < history.size(); }
+    
+    // step back over the last edit and return it in *edit; false when
+    // there is nothing to undo
+    bool undo(model_edit *edit){
+        if(!can_undo())
+            return false;
+        *edit = history[--done];
+        if(edit->kind == model_edit::cell_selected)
+            apply_deselect(edit->x, edit->y);
+        else if(edit->kind == model_edit::cell_deselected)
+            apply_select(edit->x, edit->y);
+        else
+            set_state(fits[edit->index].before);
+        return true;
+    }
+    
+    // replay the last undone edit and return it in *edit; false when there
+    // is nothing to redo
+    bool redo(model_edit *edit){
+        if(!can_redo())
+            return false;
+        *edit = history[done++];
+        if(edit->kind == model_edit::cell_selected)
+            apply_select(edit->x, edit->y);
+        else if(edit->kind == model_edit::cell_deselected)
+            apply_deselect(edit->x, edit->y);
+        else
+            set_state(fits[edit->index].after);
+        return true;
+    }
+    
+    // the fits on either side of a circle_refit edit
+    const circle_state& fit_before(const model_edit& edit) const { return fits[edit.index].before; }
+    const circle_state& fit_after(const model_edit& edit) const { return fits[edit.index].after; }
+    
+    circle_state state() const { return circle_state{fitted, center_x, center_y, radius, inliers}; }
+    
+    const cell_set& selection() const { return selected; }
+    const circle_sums& moments() const { return sums; }
+    size_t count() const { return selected.size(); }
+    
+private:
+    struct fit_change {
+        circle_state before;
+        circle_state after;
+    };
+    
+    cell_set selected;
+    circle_sums sums;
+    
+    // history[0, done) is applied, history[done, end) can be redone
+    std::vector<model_edit> history;
+    std::vector<fit_change> fits;
+    size_t done = 0;
+    
+    void apply_select(int x, int y){
+        selected.insert(x, y);
+        sums.add_cell(layout, x, y);
+    }
+    
+    void apply_deselect(int x, int y){
+        selected.erase(x, y);
+        sums.remove_cell(layout, x, y);
+    }
+    
+    void set_state(const circle_state& s){
+        fitted = s.fitted;
+        center_x = s.center_x;
+        center_y = s.center_y;
+        radius = s.radius;
+        inliers = s.inliers;
+    }
+    
+    // append an edit, dropping the ones that were undone; a circle_refit
+    // gets the index of the fit change pushed right after
+    void record(model_edit edit){
+        while(history.size() > done){
+            if(history.back().kind == model_edit::circle_refit)
+                fits.pop_back();
+            history.pop_back();
+        }
+        if(edit.kind == model_edit::circle_refit)
+            edit.index = fits.size();
+        history.push_back(edit);
+        done++;
+    }
+};
+
+#endif
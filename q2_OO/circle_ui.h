@@ -0,0 +1,212 @@
+#ifndef Q2_OO_CIRCLE_UI_H
+#define Q2_OO_CIRCLE_UI_H
+
+#include <math.h>
+#include <iostream>
+#include <opencv2/opencv.hpp>
+#include "circle_model.h"
+#include "../common/grid_background.h"
+#include "../common/grid_view.h"
+#include "../common/overlay.h"
+#include "../common/raster.h"
+#include "../common/ring_kernel.h"
+
+// window view of a circleModel: it renders the visible part of the grid,
+// the selection and the fitted circle, and forwards edits to the model
+class circleUI
+{
+public:
+    // initialize sizes
+    int point_size;
+    int patch_size;
+    int image_size;
+    int point_num;
+    grid_view view;
+    
+    // selection and fit state, kept apart from the images
+    circleModel model;
+    
+    // initialize images, only the visible part of the grid is rendered
+    cv::Mat src;
+    cv::Mat frame;
+    overlay layer;
+    
+    // initialization for a point_num x point_num grid
+    circleUI(const int p, const int pn, cv::Vec3b color)
+        : circleUI(make_grid_view(pn, pn, p), color) {}
+    
+    // initialization for a given layout, e.g. a canvas the size of the
+    // whole grid
+    circleUI(const grid_view& layout, cv::Vec3b color)
+        : view(layout), model(view), dot_color(color) {
+        point_num = view.cols;
+        point_size = view.point_size;
+        patch_size = view.patch_size;
+        image_size = view.height;
+        src = cv::Mat(image_size+100, view.width, CV_8UC3, cv::Scalar(255, 255, 255));
+        draw_grid_background(&src, view, color);
+        frame = src.clone();
+    }
+    
+    // select or deselect a cell and paint it
+    void select(cv::Point xy, cv::Vec3b color){
+        if(model.select(xy.x, xy.y))
+            paint_cell(xy, color);
+    }
+    void deselect(cv::Point xy){
+        if(model.deselect(xy.x, xy.y))
+            paint_cell(xy, dot_color);
+    }
+    
+    // draw circle function, from the running sums of the selection;
+    // false when no circle fits the selected points
+    bool draw_circle(cv::Vec3b color){
+        
+        if(!model.fit())
+            return false;
+        if(model.method == circle_ransac)
+            std::cout << "inliers: " << model.inliers << " of " << model.count() << std::endl;
+        
+        paint_circle(color);
+        return true;
+    }
+    
+    // scroll the viewport with the w/a/s/d keys and repaint it
+    bool scroll(int key, cv::Vec3b selected_color, cv::Vec3b circle_color){
+        if(!scroll_key(&view, key))
+            return false;
+        redraw(selected_color, circle_color);
+        return true;
+    }
+    
+    void redraw(cv::Vec3b selected_color, cv::Vec3b circle_color){
+        layer.clear(&frame, src);
+        for_each_visible(model.selection(), view, [&](int x, int y){
+            paint_cell(cv::Point(x, y), selected_color);
+        });
+        if(model.fitted)
+            paint_circle(circle_color);
+    }
+    
+    // step back over or replay one edit, repainting only the cell it
+    // flipped or the circle it replaced; false when there is none
+    bool undo(cv::Vec3b selected_color, cv::Vec3b circle_color){
+        model_edit edit;
+        if(!model.undo(&edit))
+            return false;
+        if(edit.kind == model_edit::circle_refit)
+            show_refit(model.fit_after(edit), selected_color, circle_color);
+        else
+            show_cell(edit, selected_color);
+        return true;
+    }
+    bool redo(cv::Vec3b selected_color, cv::Vec3b circle_color){
+        model_edit edit;
+        if(!model.redo(&edit))
+            return false;
+        if(edit.kind == model_edit::circle_refit)
+            show_refit(model.fit_before(edit), selected_color, circle_color);
+        else
+            show_cell(edit, selected_color);
+        return true;
+    }
+    
+    // reset
+    void reset(){
+        layer.clear(&frame, src);
+        model.reset();
+    }
+    
+private:
+    cv::Vec3b dot_color;
+    
+    void paint_cell(cv::Point xy, cv::Vec3b color){
+        
+        // only cells inside the viewport are rendered
+        if(!view.visible(xy.x, xy.y))
+            return;
+        
+        layer.add_cell(view, xy.x, xy.y);
+        
+        // rescale the selected point back to the original size
+        xy.x = view.pixel_x(xy.x);
+        xy.y = view.pixel_y(xy.y);
+        
+        // draw the points in specified color
+        for(int jj = 0; jj<point_size; jj++){
+            for(int ii = 0; ii<point_size; ii++){
+                frame.at<cv::Vec3b>(xy.y+jj, xy.x+ii) = color;
+            }
+        }
+    }
+    
+    void show_cell(const model_edit& edit, cv::Vec3b selected_color){
+        cv::Point xy(edit.x, edit.y);
+        paint_cell(xy, model.selection().contains(edit.x, edit.y) ? selected_color : dot_color);
+    }
+    
+    // replace the circle that was shown with the current one
+    void show_refit(const circle_state& shown, cv::Vec3b selected_color, cv::Vec3b circle_color){
+        if(shown.fitted)
+            erase_circle(shown, selected_color);
+        if(model.fitted)
+            paint_circle(circle_color);
+    }
+    
+    // restore the background under a painted circle, then the selected
+    // cells it crossed
+    void erase_circle(const circle_state& shown, cv::Vec3b selected_color){
+        int mx = (int)lround(shown.center_x - view.offset_x());
+        int my = (int)lround(shown.center_y - view.offset_y());
+        
+        // the center marker, then the band the anti-aliased ring covers
+        int x0 = mx, y0 = my, x1 = mx + 1, y1 = my + 1;
+        auto restore = [this](int x, int y){
+            frame.at<cv::Vec3b>(y, x) = src.at<cv::Vec3b>(y, x);
+        };
+        if(mx>=0 && mx<view.width && my>=0 && my<view.height)
+            restore(mx, my);
+        layer.forget_rect(cv::Rect(mx, my, 1, 1));
+        layer.forget_ring(mx, my, shown.radius, 2.);
+        int64_t lo, hi, box[4];
+        if(ring_kernel::ring_bounds(view.width, view.height, mx, my, shown.radius, 2., &lo, &hi, box)){
+            ring_kernel::ring_rect(box[0], box[1], box[2], box[3], mx, my, lo, hi, restore);
+            x0 = std::min<int64_t>(x0, box[0]);
+            y0 = std::min<int64_t>(y0, box[1]);
+            x1 = std::max<int64_t>(x1, box[2]);
+            y1 = std::max<int64_t>(y1, box[3]);
+        }
+        x0 = std::max(x0, 0);
+        y0 = std::max(y0, 0);
+        x1 = std::min(x1, view.width);
+        y1 = std::min(y1, view.height);
+        if(x1 <= x0 || y1 <= y0)
+            return;
+        model.selection().for_each_in_rect(view.cell_x(x0), view.cell_y(y0), view.cell_x(x1 - 1) + 1, view.cell_y(y1 - 1) + 1,
+                                           [&](int x, int y){ paint_cell(cv::Point(x, y), selected_color); });
+    }
+    
+    void paint_circle(cv::Vec3b color){
+        
+        double cx = model.center_x - view.offset_x();
+        double cy = model.center_y - view.offset_y();
+        int mx = (int)lround(cx);
+        int my = (int)lround(cy);
+        
+        // mark the center as red (added to better visualize the result)
+        if(mx>=0 && mx<view.width && my>=0 && my<view.height)
+            frame.at<cv::Vec3b>(my, mx) = color;
+        
+        // draw the calculated circle anti-aliased, at its sub-pixel position
+        raster::smooth_circle(cx, cy, model.radius, view.width, view.height, true, [this, color](int x, int y, float coverage){
+            cv::Vec3b& pixel = frame.at<cv::Vec3b>(y, x);
+            for(int c = 0; c<3; c++)
+                pixel[c] = (uchar)lround(pixel[c] + (color[c] - pixel[c])*coverage);
+        });
+        layer.add_rect(cv::Rect(mx, my, 1, 1));
+        layer.add_ring(mx, my, model.radius, 2.);
+    }
+    
+};
+
+#endif
@@ -0,0 +1,138 @@
+// Fits an ellipse to every set of a point-set file (see common/pointset_io.h
+// and "batch convert" in q2_OO/batch.cpp), reading the points straight from
+// the mapping, and writes one CSV row per set:
+//
+//     index,points,found,center_x,center_y,width,height,angle
+//
+// With --stream it runs as a filter instead: points and "fit" delimiters
+// (see common/point_stream.h) are read from stdin, a file or a FIFO and the
+// row of every set is written as soon as the set is complete.
+//
+// usage: batch [--threads N] input.pset [output]
+//        batch --stream [--threads N] [input]
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "draw.h"
+#include "../common/point_stream.h"
+#include "../common/pointset_io.h"
+#include "../common/thread_pool.h"
+
+struct ellipse_fit {
+    bool found;
+    cv::RotatedRect box;
+};
+
+template<class T>
+static std::vector<ellipse_fit> fit_sets(size_t count, const uint64_t *offsets, const T *xs, const T *ys){
+    std::vector<ellipse_fit> fits(count);
+    parallel::parallel_for_stealing(0, (int64_t)fits.size(), 64, [&](int64_t begin, int64_t end){
+        for(int64_t k = begin; k<end; k++){
+            size_t n = (size_t)(offsets[k+1] - offsets[k]);
+            fits[k].found = q3::fit_ellipse(xs + offsets[k], ys + offsets[k], n, &fits[k].box);
+        }
+    });
+    return fits;
+}
+
+static void write_fit(FILE *out, uint64_t index, uint64_t points, const ellipse_fit& fit){
+    const cv::RotatedRect& b = fit.box;
+    if(fit.found)
+        fprintf(out, "%llu,%llu,1,%g,%g,%g,%g,%g\n", (unsigned long long)index, (unsigned long long)points,
+                b.center.x, b.center.y, b.size.width, b.size.height, b.angle);
+    else
+        fprintf(out, "%llu,%llu,0,0,0,0,0,0\n", (unsigned long long)index, (unsigned long long)points);
+}
+
+static int stream(const char *input){
+    int fd = 0;
+    if(input != NULL && strcmp(input, "-") != 0){
+        fd = open(input, O_RDONLY);
+        if(fd < 0){
+            std::cerr << "Error: cannot open " << input << std::endl;
+            return 1;
+        }
+    }
+
+    // the reader parses the next batch while this one is fitted
+    point_stream::batch sets;
+    point_stream::reader reader(fd);
+    printf("index,points,found,center_x,center_y,width,height,angle\n");
+    while(reader.next(&sets)){
+        std::vector<ellipse_fit> fits = fit_sets(sets.size(), sets.offsets.data(), sets.xs.data(), sets.ys.data());
+        for(size_t k = 0; k<fits.size(); k++)
+            write_fit(stdout, sets.first + k, sets.offsets[k+1] - sets.offsets[k], fits[k]);
+        fflush(stdout);
+    }
+    if(fd != 0)
+        close(fd);
+    if(!reader.error().empty()){
+        std::cerr << "Error: " << reader.error() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *usage = "usage: batch [--threads N] input.pset [output]\n"
+                        "       batch --stream [--threads N] [input]";
+    int threads = 0;
+    bool streaming = false;
+    const char *input = NULL;
+    const char *output = NULL;
+    for(int k = 1; k<argc; k++){
+        std::string arg = argv[k];
+        if(arg == "--threads" && k+1<argc)
+            threads = atoi(argv[++k]);
+        else if(arg == "--stream")
+            streaming = true;
+        else if(input == NULL)
+            input = argv[k];
+        else if(output == NULL)
+            output = argv[k];
+        else{
+            std::cerr << usage << std::endl;
+            return 1;
+        }
+    }
+    if(threads > 0)
+        parallel::set_thread_count(threads);
+    if(streaming && output == NULL)
+        return stream(input);
+    if(input == NULL || streaming){
+        std::cerr << usage << std::endl;
+        return 1;
+    }
+
+    pointset_io::mapped_sets sets;
+    if(!sets.open(input)){
+        std::cerr << "Error: " << input << ": " << sets.error() << std::endl;
+        return 1;
+    }
+    std::vector<ellipse_fit> fits = sets.type() == pointset_io::COORD_INT32 ?
+        fit_sets(sets.set_count(), sets.offsets(), sets.xs<int32_t>(), sets.ys<int32_t>()) :
+        fit_sets(sets.set_count(), sets.offsets(), sets.xs<float>(), sets.ys<float>());
+
+    FILE *out = stdout;
+    if(output != NULL && strcmp(output, "-") != 0){
+        out = fopen(output, "w");
+        if(out == NULL){
+            std::cerr << "Error: cannot write " << output << std::endl;
+            return 1;
+        }
+    }
+    const uint64_t *offsets = sets.offsets();
+    fprintf(out, "index,points,found,center_x,center_y,width,height,angle\n");
+    for(size_t k = 0; k<fits.size(); k++)
+        write_fit(out, k, offsets[k+1] - offsets[k], fits[k]);
+    if(out != stdout)
+        fclose(out);
+    return 0;
+}
@@ -0,0 +1,157 @@
+#ifndef Q3_DRAW_H
+#define Q3_DRAW_H
+
+#include <math.h>
+#include <iostream>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "../common/ellipse_detect.h"
+#include "../common/ellipse_fit.h"
+#include "../common/grid_view.h"
+#include "../common/overlay.h"
+#include "../common/point_set.h"
+#include "../common/ransac_ellipse.h"
+#include "../common/raster.h"
+#include "selection.h"
+
+namespace q3 {
+
+// direct fit from the running moments, cv::fitEllipse over the points, or
+// RANSAC over the points for selections with stray cells
+enum ellipse_method { ellipse_direct, ellipse_opencv, ellipse_ransac };
+
+inline const char *ellipse_method_name(ellipse_method method){
+    const char *names[] = {"Direct", "OpenCV", "RANSAC"};
+    return names[method];
+}
+
+inline ellipse_method next_ellipse_method(ellipse_method method){
+    return (ellipse_method)((method + 1) % 3);
+}
+
+inline void draw(cv::Mat *frame, const grid_view& view, cv::Point xy, cv::Vec3b color, overlay *layer = NULL){
+    
+    // only cells inside the viewport are rendered
+    if(!view.visible(xy.x, xy.y))
+        return;
+    
+    if(layer != NULL)
+        layer->add_cell(view, xy.x, xy.y);
+    
+    // rescale the selected point back to the original size
+    xy.x = view.pixel_x(xy.x);
+    xy.y = view.pixel_y(xy.y);
+    
+    // draw the points in specified color
+    for(int jj = 0; jj<view.point_size; jj++){
+        for(int ii = 0; ii<view.point_size; ii++){
+            (*frame).at<cv::Vec3b>(xy.y+jj, xy.x+ii) = color;
+        }
+    }
+}
+
+// draw an ellipse given in canvas pixels into the viewport, at its
+// sub-pixel position, blending each pixel by its coverage. The layer gets
+// the runs of plotted pixels, so a restore touches the outline only.
+inline void paint_ellipse(cv::Mat *frame, const grid_view& view, cv::RotatedRect theEllipse, cv::Vec3b color, overlay *layer = NULL,
+                          bool antialias = true, double thickness = 1.){
+    theEllipse.center.x -= (float)view.offset_x();
+    theEllipse.center.y -= (float)view.offset_y();
+
+    // pixels come row by row in increasing x
+    int run_x = 0, run_y = -1, run_end = 0;
+    auto flush = [&](){
+        if(layer != NULL && run_y >= 0)
+            layer->add_rect(cv::Rect(run_x, run_y, run_end - run_x, 1));
+    };
+    raster::smooth_ellipse(theEllipse.center.x, theEllipse.center.y, theEllipse.size.width, theEllipse.size.height,
+                           theEllipse.angle, thickness, view.width, view.height, antialias, [&](int x, int y, float coverage){
+        cv::Vec3b& pixel = (*frame).at<cv::Vec3b>(y, x);
+        for(int c = 0; c<3; c++)
+            pixel[c] = (uchar)lround(pixel[c] + (color[c] - pixel[c])*coverage);
+        if(y != run_y || x != run_end){
+            flush();
+            run_x = x;
+            run_y = y;
+        }
+        run_end = x + 1;
+    });
+    flush();
+}
+
+// fit an ellipse to n points given as two coordinate arrays, e.g. a set of
+// a point-set file; false with 5 points or fewer
+template<class T>
+inline bool fit_ellipse(const T *xs, const T *ys, size_t n, cv::RotatedRect *fitted){
+    if(n <= 5)
+        return false;
+    std::vector<cv::Point2f> points(n);
+    for(size_t k = 0; k<n; k++)
+        points[k] = cv::Point2f((float)xs[k], (float)ys[k]);
+    *fitted = cv::fitEllipse(points);
+    return true;
+}
+
+inline cv::RotatedRect to_rotated_rect(const ellipse_params& fit){
+    return cv::RotatedRect(cv::Point2f((float)fit.center_x, (float)fit.center_y),
+                           cv::Size2f((float)fit.width, (float)fit.height), (float)fit.angle);
+}
+
+// fit an ellipse to the selection with the given method; inliers receives
+// the number of points the ellipse explains (all of them for the methods
+// other than RANSAC)
+inline bool fit_selection(ellipse_method method, const selection& selected, const grid_view& view,
+                          cv::RotatedRect *fitted, size_t *inliers){
+    const point_set& points = selected.points();
+    *inliers = points.size();
+    if(method == ellipse_opencv)
+        return fit_ellipse(points.xs().data(), points.ys().data(), points.size(), fitted);
+    ellipse_params fit;
+    if(method == ellipse_ransac){
+        ransac::ellipse_result found = ransac::fit_ellipse(points.xs(), points.ys(), ransac::cell_options(view));
+        *inliers = found.inlier_count;
+        if(!found.found)
+            return false;
+        fit = found.fit;
+    }
+    else if(!selected.moments().solve(&fit))
+        return false;
+    *fitted = to_rotated_rect(fit);
+    return true;
+}
+
+// fit an ellipse to the selection and draw it; false when the selected
+// points do not determine an ellipse
+inline bool draw_ellipse(ellipse_method method, const selection& selected, const grid_view& view,
+                         cv::Mat *frame, cv::Vec3b color, cv::RotatedRect *fitted, overlay *layer = NULL){
+    size_t inliers;
+    if(!fit_selection(method, selected, view, fitted, &inliers))
+        return false;
+    if(method == ellipse_ransac)
+        std::cout << "inliers: " << inliers << " of " << selected.size() << std::endl;
+    paint_ellipse(frame, view, *fitted, color, layer);
+    return true;
+}
+
+// split the selection into connected groups of cells and fit one ellipse
+// per group; groups of 5 cells or fewer are skipped
+inline std::vector<cv::RotatedRect> detect_shapes(const point_set& points){
+    std::vector<detected_ellipse> found = detect_ellipses(points);
+    std::vector<cv::RotatedRect> shapes(found.size());
+    for(size_t k = 0; k<found.size(); k++)
+        shapes[k] = to_rotated_rect(found[k].fit);
+    return shapes;
+}
+
+// detect_shapes, then draw them all
+inline std::vector<cv::RotatedRect> draw_ellipses(const point_set& points, const grid_view& view, cv::Mat *frame,
+                                                  cv::Vec3b color, overlay *layer = NULL){
+    std::vector<cv::RotatedRect> shapes = detect_shapes(points);
+    for(size_t k = 0; k<shapes.size(); k++)
+        paint_ellipse(frame, view, shapes[k], color, layer);
+    return shapes;
+}
+
+}
+
+#endif
@@ -7,62 +7,39 @@
 #include <math.h> 
 #include <opencv2/opencv.hpp>
 #include "cvui.h"
+#include "draw.h"
+#include "../common/grid_background.h"
 
 #define WINDOW_NAME "CVUI"
 
-void draw(cv::Mat *frame, cv::Point xy, cv::Vec3b color, const int point_size, int patch_size){
-    
-    // rescale the selected point back to the original size
-    xy.x = xy.x*patch_size;
-    xy.y = xy.y*patch_size;
-    
-    // draw the points in specified color
-    for(int jj = 0; jj<point_size; jj++){
-        for(int ii = 0; ii<point_size; ii++){
-            (*frame).at<cv::Vec3b>(xy.y+jj, xy.x+ii) = color;
-        }
-    }
-}
-
-void draw_ellipse(cv::Mat *frame, std::vector<cv::Point> points, cv::Vec3b color){
-    
-    // initialize the parameters
-    cv::RotatedRect theEllipse;
-    
-    // find ellipse
-    if( points.size() > 5 )
-        theEllipse = cv::fitEllipse(cv::Mat(points));
-    else
-        std::cerr<<"WARNING : The system needs more than 5 points to generate an ellipse!"<<std::endl;
-    
-    // draw ellipse
-    ellipse( *frame, theEllipse, color);
-    
-}
-
-int main()
+int main(int argc, char **argv)
 {
-    // initialize sizes
+    // initialize sizes, the grid size can be given on the command line
     const int point_size = 9;
-    const int patch_size = 3*point_size;
-    const int image_size = 60*point_size;
+    int cols, rows;
+    if(!grid_size_args(argc, argv, &cols, &rows)){
+        std::cerr << "usage: main [cols [rows]]" << std::endl;
+        return 1;
+    }
+    grid_view view = make_grid_view(cols, rows, point_size);
+    const int image_size = view.height;
     
     // initialize colors
     cv::Vec3b gray(150, 150, 150);
     cv::Vec3b blue(255, 0, 0);
     cv::Vec3b red(0, 0, 255);
     
-    // initialize images
-    cv::Mat src(image_size+100, image_size, CV_8UC3, cv::Scalar(255, 255, 255));
-    cv::Mat src_ref = cv::Mat::zeros(20, 20, CV_32F);
-    for(int j=0; j<image_size; j++){
-        for(int i=0; i<image_size; i++){
-            if(i%patch_size<point_size && j%patch_size<point_size){
-                src.at<cv::Vec3b>(j, i) = gray;
-            }
-        }
-    }
+    // initialize images, only the visible part of the grid is rendered and
+    // the selection is kept apart from it, as one packed point array with
+    // the moments of the direct fit
+    cv::Mat src(view.height+100, view.width, CV_8UC3, cv::Scalar(255, 255, 255));
+    q3::selection selected(view);
+    draw_grid_background(&src, view, gray);
     cv::Mat frame = src.clone();
+    
+    // everything drawn over the grid is tracked so it can be undone
+    // without copying the whole frame
+    overlay layer;
 
     // Init a OpenCV window and tell cvui to use it.
     cv::namedWindow(WINDOW_NAME);
@@ -70,59 +47,99 @@ int main()
     
     // initialize templates and paremeters
     cv::Point cursor;
-    std::vector<cv::Point> cir_points;
-    float radius, radius_tmp;
+    q3::ellipse_method method = q3::ellipse_direct;
+    cv::RotatedRect fitted;
+    std::vector<cv::RotatedRect> detected;
+    bool detecting = false;
     int count = 0;
     bool clicked = false;
+    bool repaint = false;
     
     while (true)
     {
         // generate the circle when click the 'generate' button
-        if (cvui::button(frame, image_size/2-80, image_size+30, 100, 40, "Generate")){
+        if (cvui::button(frame, view.width/2-80, image_size+30, 100, 40, "Generate")){
             // to regularize the generate behavior
             if(!clicked){
-                draw_ellipse(&frame, cir_points, blue);
-                clicked = true;
+                clicked = q3::draw_ellipse(method, selected, view, &frame, blue, &fitted, &layer);
+                if(!clicked)
+                    std::cerr<<"WARNING : The system needs more than 5 points to generate an ellipse!"<<std::endl;
+            }
+        }
+        
+        // fit one ellipse per connected group of selected cells when click
+        // the 'detect' button
+        if (cvui::button(frame, view.width/2-200, image_size+30, 100, 40, "Detect")){
+            if(!detecting){
+                detected = q3::draw_ellipses(selected.points(), view, &frame, blue, &layer);
+                detecting = true;
+                std::cout << "ellipses found: " << detected.size() << std::endl;
             }
         }
         
+        // cycle through the direct fit, cv::fitEllipse and RANSAC
+        if (cvui::button(frame, view.width/2+40, image_size+30, 100, 40, q3::ellipse_method_name(method))){
+            method = q3::next_ellipse_method(method);
+            std::cout << "fit method: " << q3::ellipse_method_name(method) << std::endl;
+        }
+        
         // deal with selecting points
         if (cvui::mouse(cvui::LEFT_BUTTON, cvui::UP)){
             cursor = cvui::mouse();
-            cursor.x = cursor.x/patch_size;
-            cursor.y = cursor.y/patch_size;
-            cir_points.push_back(cv::Point(cursor.x*patch_size+(point_size+1)/2, cursor.y*patch_size+(point_size+1)/2));
-            // mark the point if it hasn't been selected
-            if(frame.at<cv::Vec3b>(cursor.y*patch_size+1, cursor.x*patch_size+1)==gray){
-                src_ref.at<float>(cursor.y, cursor.x) = 1.;
-                draw(&frame, cursor, blue, point_size, patch_size);
-            }
+            cursor.x = view.cell_x(cursor.x);
+            cursor.y = view.cell_y(cursor.y);
+            // mark the point if it hasn't been selected, unmark it if it
+            // has
+            if(view.visible(cursor.x, cursor.y))
+                q3::draw(&frame, view, cursor, selected.toggle(cursor.x, cursor.y) ? blue : gray, &layer);
             
-            // unmark the point if it has already been selected
-            else if(frame.at<cv::Vec3b>(cursor.y*patch_size+1, cursor.x*patch_size+1)==blue){
-                src_ref.at<float>(cursor.y, cursor.x) = 0.;
-                draw(&frame, cursor, gray, point_size, patch_size);
+            // once generated, the ellipse follows every click
+            if(clicked && view.visible(cursor.x, cursor.y)){
+                size_t inliers;
+                clicked = q3::fit_selection(method, selected, view, &fitted, &inliers);
+                repaint = true;
+            }
+            if(detecting && view.visible(cursor.x, cursor.y)){
+                detected = q3::detect_shapes(selected.points());
+                repaint = true;
             }
         }
         
         // reset the system by right clicking the mouse
         if (cvui::mouse(cvui::RIGHT_BUTTON, cvui::UP)){
-            src.copyTo(frame);
-            src_ref = cv::Mat::zeros(20, 20, CV_32F);
+            layer.clear(&frame, src);
+            selected.clear();
             count = 0;
             clicked = false;
-            cir_points.clear();
+            detecting = false;
+            detected.clear();
+        }
+        
+        // repaint the viewport after scrolling
+        if(repaint){
+            layer.clear(&frame, src);
+            for_each_visible(selected.points(), view, [&](int x, int y){
+                q3::draw(&frame, view, cv::Point(x, y), blue, &layer);
+            });
+            if(clicked)
+                q3::paint_ellipse(&frame, view, fitted, blue, &layer);
+            for(size_t k = 0; k<detected.size(); k++)
+                q3::paint_ellipse(&frame, view, detected[k], blue, &layer);
+            repaint = false;
         }
         
         // Update cvui internal stuff
         cvui::update();
         imshow(WINDOW_NAME, frame);
         
-        // press ESC to exit the system
-        if (cv::waitKey(30) == 27)
+        // press ESC to exit the system, w/a/s/d to scroll
+        int key = cv::waitKey(30);
+        if (key == 27)
         {
             break;
         }
+        if (scroll_key(&view, key))
+            repaint = true;
     }
     return 0;
 }
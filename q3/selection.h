@@ -0,0 +1,65 @@
+#ifndef Q3_SELECTION_H
+#define Q3_SELECTION_H
+
+// The selected cells of q3, kept once. The indexed point set is the only
+// record of which cells are selected; the running moments of the direct
+// fit follow it and change only when a cell actually enters or leaves the
+// set, so the two can never disagree.
+
+#include <stddef.h>
+#include "../common/ellipse_fit.h"
+#include "../common/grid_view.h"
+#include "../common/point_set.h"
+
+namespace q3 {
+
+class selection
+{
+public:
+    explicit selection(const grid_view& layout) : layout(layout), cells(layout) {}
+
+    bool contains(int x, int y) const { return cells.contains(x, y); }
+
+    // select a cell; false when it is already selected
+    bool insert(int x, int y){
+        if(!cells.insert(x, y))
+            return false;
+        sums.add_cell(layout, x, y);
+        return true;
+    }
+
+    // deselect a cell; false when it was not selected
+    bool erase(int x, int y){
+        if(!cells.erase(x, y))
+            return false;
+        sums.remove_cell(layout, x, y);
+        return true;
+    }
+
+    // flip a cell and return whether it is now selected
+    bool toggle(int x, int y){
+        if(erase(x, y))
+            return false;
+        return insert(x, y);
+    }
+
+    void clear(){
+        cells.clear();
+        sums.clear();
+    }
+
+    size_t size() const { return cells.size(); }
+
+    // the selected cell centers as one packed array, and their moments
+    const point_set& points() const { return cells; }
+    const ellipse_sums& moments() const { return sums; }
+
+private:
+    grid_view layout;
+    point_set cells;
+    ellipse_sums sums;
+};
+
+}
+
+#endif